@@ -0,0 +1,202 @@
+// binary road network(.cgraph), converted once from the text .cnode/.cedge files
+// by cgraph_convert and loaded with a single mmap
+//
+// [CGraphHeader][x, y of each node as double][CGraphEdge * edge_count]
+#ifndef CGRAPH_H
+#define CGRAPH_H
+
+#include<stdio.h>
+#include<string.h>
+#include<vector>
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+using namespace std;
+
+#define CGRAPH_MAGIC 0x48505247 // "GRPH"
+#define CGRAPH_VERSION 1
+
+typedef struct{
+	int magic;
+	int version;
+	int node_count;
+	int edge_count;
+	int directed; // 0 = every edge goes both ways(.cedge), 1 = one way
+	int reserved;
+}CGraphHeader;
+
+typedef struct{
+	int snid;
+	int enid;
+	double weight; // as in the text file, programs apply their own factors
+}CGraphEdge;
+
+struct CGraph{
+	int node_count;
+	int edge_count;
+	int directed;
+	const double *xy; // x, y of node i = xy[2*i], xy[2*i+1]
+	const CGraphEdge *edges;
+	// storage, a mapped file or parsed text
+	void *map;
+	long long maplen;
+	vector<double> textxy;
+	vector<CGraphEdge> textedges;
+
+	CGraph(){ node_count = edge_count = directed = 0; xy = NULL; edges = NULL; map = NULL; maplen = 0; }
+};
+
+// check edge ids, prints the first bad edge
+inline bool cgraph_validate( CGraph &g ){
+	for ( int i = 0; i < g.edge_count; i++ ){
+		if ( g.edges[i].snid < 0 || g.edges[i].snid >= g.node_count || g.edges[i].enid < 0 || g.edges[i].enid >= g.node_count ){
+			printf("CGRAPH: EDGE %d (%d, %d) OUT OF NODE RANGE [0, %d)\n", i, g.edges[i].snid, g.edges[i].enid, g.node_count);
+			return false;
+		}
+	}
+	return true;
+}
+
+// does file exist, whatever it holds
+inline bool cgraph_exists( const char *file ){
+	struct stat st;
+	return stat( file, &st ) == 0;
+}
+
+// is file a binary graph
+inline bool cgraph_is_binary( const char *file ){
+	FILE *fin = fopen( file, "rb" );
+	if ( fin == NULL ) return false;
+	int magic = 0;
+	bool is = fread( &magic, sizeof(int), 1, fin ) == 1 && magic == CGRAPH_MAGIC;
+	fclose(fin);
+	return is;
+}
+
+// release storage
+inline void cgraph_close( CGraph &g ){
+	if ( g.map != NULL ) munmap( g.map, g.maplen );
+	g.map = NULL;
+	vector<double>().swap( g.textxy );
+	vector<CGraphEdge>().swap( g.textedges );
+	g.xy = NULL;
+	g.edges = NULL;
+}
+
+// map a binary graph read-only, nothing stays mapped on failure
+inline bool cgraph_open( const char *file, CGraph &g ){
+	int fd = open( file, O_RDONLY );
+	if ( fd < 0 ){
+		printf("CGRAPH: CANNOT OPEN %s\n", file);
+		return false;
+	}
+	struct stat st;
+	if ( fstat( fd, &st ) != 0 || st.st_size < sizeof(CGraphHeader) ){
+		printf("CGRAPH: %s TOO SHORT\n", file);
+		close(fd);
+		return false;
+	}
+	void *base = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+	close(fd);
+	if ( base == MAP_FAILED ){
+		printf("CGRAPH: CANNOT MAP %s\n", file);
+		return false;
+	}
+	g.map = base;
+	g.maplen = st.st_size;
+
+	const CGraphHeader *header = (const CGraphHeader*)base;
+	long long expected = sizeof(CGraphHeader) + sizeof(double) * 2 * (long long)header->node_count + sizeof(CGraphEdge) * (long long)header->edge_count;
+	if ( header->magic != CGRAPH_MAGIC ){
+		printf("CGRAPH: %s IS NOT A BINARY GRAPH(BAD MAGIC), REMOVE IT OR RERUN cgraph_convert\n", file);
+		cgraph_close( g );
+		return false;
+	}
+	if ( header->version != CGRAPH_VERSION ){
+		printf("CGRAPH: %s VERSION %d, EXPECTED %d, RERUN cgraph_convert\n", file, header->version, CGRAPH_VERSION);
+		cgraph_close( g );
+		return false;
+	}
+	if ( header->node_count < 0 || header->edge_count < 0 || expected != st.st_size ){
+		printf("CGRAPH: %s SIZE %lld, EXPECTED %lld FOR %d NODES %d EDGES\n", file, (long long)st.st_size, expected, header->node_count, header->edge_count);
+		cgraph_close( g );
+		return false;
+	}
+	g.node_count = header->node_count;
+	g.edge_count = header->edge_count;
+	g.directed = header->directed;
+	g.xy = (const double*)( (const char*)base + sizeof(CGraphHeader) );
+	g.edges = (const CGraphEdge*)( g.xy + 2 * (long long)g.node_count );
+	if ( ! cgraph_validate( g ) ){
+		cgraph_close( g );
+		return false;
+	}
+	return true;
+}
+
+// parse text node file("id x y" per line) and edge file("id snid enid weight" per line)
+// nodes are numbered by line, edgefile may be NULL
+inline bool cgraph_load_text( const char *nodefile, const char *edgefile, CGraph &g ){
+	FILE *fin = fopen( nodefile, "r" );
+	if ( fin == NULL ){
+		printf("CGRAPH: CANNOT OPEN %s\n", nodefile);
+		return false;
+	}
+	int nid;
+	double x, y;
+	while( fscanf(fin, "%d %lf %lf", &nid, &x, &y ) == 3 ){
+		g.textxy.push_back(x);
+		g.textxy.push_back(y);
+	}
+	fclose(fin);
+
+	if ( edgefile != NULL ){
+		fin = fopen( edgefile, "r" );
+		if ( fin == NULL ){
+			printf("CGRAPH: CANNOT OPEN %s\n", edgefile);
+			return false;
+		}
+		int eid;
+		CGraphEdge e;
+		while( fscanf(fin,"%d %d %d %lf", &eid, &e.snid, &e.enid, &e.weight ) == 4 ){
+			g.textedges.push_back(e);
+		}
+		fclose(fin);
+	}
+
+	g.node_count = g.textxy.size() / 2;
+	g.edge_count = g.textedges.size();
+	g.directed = 0;
+	g.xy = g.textxy.data();
+	g.edges = g.textedges.data();
+	return cgraph_validate( g );
+}
+
+// load the binary graph file if it exists, the text files only if it does not,
+// a file that is present but not a valid binary graph is an error
+inline bool cgraph_load( const char *file, const char *nodefile, const char *edgefile, CGraph &g ){
+	if ( cgraph_exists( file ) ){
+		return cgraph_open( file, g );
+	}
+	return cgraph_load_text( nodefile, edgefile, g );
+}
+
+inline bool cgraph_save( const char *file, CGraph &g ){
+	FILE *fout = fopen( file, "wb" );
+	if ( fout == NULL ) return false;
+	CGraphHeader header;
+	memset( &header, 0, sizeof(header) );
+	header.magic = CGRAPH_MAGIC;
+	header.version = CGRAPH_VERSION;
+	header.node_count = g.node_count;
+	header.edge_count = g.edge_count;
+	header.directed = g.directed;
+	bool ok = fwrite( &header, sizeof(header), 1, fout ) == 1;
+	ok = ok && fwrite( g.xy, sizeof(double) * 2, g.node_count, fout ) == g.node_count;
+	ok = ok && fwrite( g.edges, sizeof(CGraphEdge), g.edge_count, fout ) == g.edge_count;
+	fclose(fout);
+	return ok;
+}
+
+#endif
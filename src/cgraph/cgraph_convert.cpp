@@ -0,0 +1,113 @@
+// convert a text road network to the binary graph(.cgraph) read by cgraph_load
+//
+// usage: cgraph_convert NODEFILE EDGEFILE OUTFILE
+//          NODEFILE = "id x y" per line, EDGEFILE = "id snid enid weight" per line(two-way edges,
+//          the gtree_build, gtree_query and SILC input)
+//        cgraph_convert -d EDGEFILE [NODEFILE] OUTFILE
+//          EDGEFILE = "n m" then m lines of 1-based "u v c"(one-way edges, the GPTree input),
+//          NODEFILE = "id x y" per line, coordinates are 0 if omitted
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<vector>
+#include<sys/time.h>
+#include"cgraph.h"
+using namespace std;
+
+// ----------
+struct timeval tv;
+long long ts, te;
+#define TIME_TICK_START gettimeofday( &tv, NULL ); ts = tv.tv_sec * 100000 + tv.tv_usec / 10;
+#define TIME_TICK_END gettimeofday( &tv, NULL ); te = tv.tv_sec * 100000 + tv.tv_usec / 10;
+#define TIME_TICK_PRINT(T) printf("%s RESULT: %lld (0.01MS)\r\n", (#T), te - ts );
+// ----------
+
+// read the GPTree edge file, ids are turned 0-based
+bool load_directed( const char *edgefile, const char *nodefile, CGraph &g ){
+	FILE *fin = fopen( edgefile, "r" );
+	if ( fin == NULL ){
+		printf("CANNOT OPEN %s\n", edgefile);
+		return false;
+	}
+	int n, m;
+	if ( fscanf(fin, "%d %d", &n, &m ) != 2 || n < 0 || m < 0 ){
+		printf("BAD HEADER IN %s\n", edgefile);
+		fclose(fin);
+		return false;
+	}
+	g.textedges.resize( m );
+	for ( int i = 0; i < m; i++ ){
+		int u, v, c;
+		if ( fscanf(fin, "%d %d %d", &u, &v, &c ) != 3 ){
+			printf("%s HAS %d EDGES, HEADER SAYS %d\n", edgefile, i, m);
+			fclose(fin);
+			return false;
+		}
+		g.textedges[i].snid = u - 1;
+		g.textedges[i].enid = v - 1;
+		g.textedges[i].weight = c;
+	}
+	fclose(fin);
+
+	g.textxy.assign( 2 * (long long)n, 0 );
+	if ( nodefile != NULL ){
+		fin = fopen( nodefile, "r" );
+		if ( fin == NULL ){
+			printf("CANNOT OPEN %s\n", nodefile);
+			return false;
+		}
+		int nid, i = 0;
+		double x, y;
+		while( i < n && fscanf(fin, "%d %lf %lf", &nid, &x, &y ) == 3 ){
+			g.textxy[2 * i] = x;
+			g.textxy[2 * i + 1] = y;
+			i++;
+		}
+		fclose(fin);
+		if ( i != n ){
+			printf("%s HAS %d NODES, %s SAYS %d\n", nodefile, i, edgefile, n);
+			return false;
+		}
+	}
+
+	g.node_count = n;
+	g.edge_count = m;
+	g.directed = 1;
+	g.xy = g.textxy.data();
+	g.edges = g.textedges.data();
+	return cgraph_validate( g );
+}
+
+int main( int argc, char **argv ){
+	CGraph g;
+	const char *outfile;
+	bool ok;
+
+	TIME_TICK_START
+	if ( argc == 4 && strcmp( argv[1], "-d" ) != 0 ){
+		outfile = argv[3];
+		ok = cgraph_load_text( argv[1], argv[2], g );
+	}
+	else if ( ( argc == 4 || argc == 5 ) && strcmp( argv[1], "-d" ) == 0 ){
+		outfile = argv[argc - 1];
+		ok = load_directed( argv[2], argc == 5 ? argv[3] : NULL, g );
+	}
+	else{
+		printf("usage: %s NODEFILE EDGEFILE OUTFILE\n", argv[0]);
+		printf("       %s -d EDGEFILE [NODEFILE] OUTFILE\n", argv[0]);
+		return 1;
+	}
+	if ( !ok ){
+		return 1;
+	}
+	TIME_TICK_END
+	TIME_TICK_PRINT("PARSE")
+
+	if ( !cgraph_save( outfile, g ) ){
+		printf("CANNOT WRITE %s\n", outfile);
+		return 1;
+	}
+	printf("NODE_COUNT=%d EDGE_COUNT=%d DIRECTED=%d -> %s\n", g.node_count, g.edge_count, g.directed, outfile);
+	cgraph_close( g );
+	return 0;
+}
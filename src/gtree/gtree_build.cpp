@@ -13,8 +13,20 @@
 #include<stack>
 #include<algorithm>
 #include<sys/time.h>
+#include<unistd.h>
+#include<sys/wait.h>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<atomic>
 using namespace std;
 
+#include"gtree_graph.h"
+#include"gtree_dijkstra.h"
+#include"gtree_index.h"
+#include"gtree_leafdist.h"
+#include"../cgraph/cgraph.h"
+
 // MACRO for timing
 struct timeval tv;
 long long ts, te;
@@ -25,26 +37,28 @@ long long ts, te;
 
 #define FILE_NODE "cal.cnode"
 #define FILE_EDGE "cal.cedge"
+#define FILE_GRAPH "cal.cgraph" // binary graph of cgraph_convert, used instead of the two above if present
 // set all edge weight to 1(unweighted graph)
 #define ADJWEIGHT_SET_TO_ALL_ONE true
 // we assume edge weight is integer, thus (input edge) * WEIGHT_INFLATE_FACTOR = (our edge weight)
 #define WEIGHT_INFLATE_FACTOR 100000
-// gtree fanout
+// gtree fanout, default of -f
 #define PARTITION_PART 4
-// gtree leaf node capacity = tau(in paper)
+// gtree leaf node capacity = tau(in paper), default of -l
 #define LEAF_CAP 32
 // gtree index disk storage
 #define FILE_NODES_GTREE_PATH "cal.paths"
 #define FILE_GTREE 			  "cal.gtree"
 #define FILE_ONTREE_MIND	  "cal.minds"
-
-typedef struct{
-	double x,y;
-	vector<int> adjnodes;
-	vector<int> adjweight;
-	bool isborder;
-	vector<int> gtreepath; // this is used to do sub-graph locating
-}Node;
+#define FILE_GTREE_INDEX	  "cal.gidx" // single-file index, mapped in place by gtree_query
+#define FILE_VERTEX_ORDER	  "cal.order" // new id of each vertex if renumbered(-r), for the three files above
+#define FILE_LEAF_DIST		  "cal.leafd" // in-leaf all-pairs distances(-a), see gtree_leafdist.h
+// stock METIS 5.1 keeps the GKlib random generator state in process globals, so with
+// -t > 1 partition calls run in forked helper processes unless METIS is built reentrant
+#define METIS_REENTRANT false
+// seed of every partition call, the same for all subtrees so the tree does not depend on
+// which thread or helper partitions a subtree
+#define METIS_SEED 4321
 
 typedef struct{
 	vector<int> borders;
@@ -63,22 +77,45 @@ typedef struct{
 }TreeNode;
 
 int noe; // number of edges
-vector<Node> Nodes;
+Graph Nodes;
+vector<bool> isborder; // border of any tree node
+vector<int> vertex_order; // new id of each input vertex, empty if not renumbered
 vector<TreeNode> GTree;
 
 // use for metis
 // idx_t = int64_t / real_t = double
-idx_t nvtxs; // |vertices|
-idx_t ncon; // number of weight per vertex
-idx_t* xadj; // array of adjacency of indices
-idx_t* adjncy; // array of adjacency nodes
-idx_t* vwgt; // array of weight of nodes
-idx_t* adjwgt; // array of weight of edges in adjncy
-idx_t nparts; // number of parts to partition
-idx_t objval; // edge cut for partitioning solution
-idx_t* part; // array of partition vector
+typedef struct{
+	idx_t nvtxs; // |vertices|
+	idx_t ncon; // number of weight per vertex
+	idx_t* xadj; // array of adjacency of indices
+	idx_t* adjncy; // array of adjacency nodes
+	idx_t* adjwgt; // array of weight of edges in adjncy
+	idx_t nparts; // number of parts to partition
+	idx_t objval; // edge cut for partitioning solution
+	idx_t* part; // array of partition vector
+}MetisGraph; // one per partition task, so that sibling subtrees can be partitioned at once
 idx_t options[METIS_NOPTIONS]; // option array
 
+// partition helper process of a build worker, see METIS_REENTRANT
+typedef struct{
+	pid_t pid;
+	int to; // request pipe: nvtxs, xadj, adjncy, adjwgt
+	int from; // reply pipe: objval, part
+}MetisHelper;
+vector<MetisHelper> metis_helpers; // one per build worker, empty to call METIS in process
+
+// number of threads used by build()
+int build_threads = 1;
+// compress distance matrices of the single-file index
+bool mind_compress = false;
+// gtree fanout and leaf capacity, recorded in the single-file index
+int partition_part = PARTITION_PART;
+int leaf_cap = LEAF_CAP;
+// renumber vertices in DFS leaf order
+bool renumber = false;
+// write in-leaf all-pairs distances
+bool leaf_dist = false;
+
 // METIS setting options
 void options_setting(){
 	METIS_SetDefaultOptions(options);
@@ -93,56 +130,65 @@ void options_setting(){
 	options[METIS_OPTION_UFACTOR] = 500;
 	// options[METIS_OPTION_MINCONN];
 	options[METIS_OPTION_CONTIG] = 1;
-	// options[METIS_OPTION_SEED];
+	options[METIS_OPTION_SEED] = METIS_SEED;
 	options[METIS_OPTION_NUMBERING] = 0;
 	// options[METIS_OPTION_DBGLVL] = 0;
 }
 
 // input init
 void init_input(){
-	FILE *fin;
+	CGraph cg;
 
-	// load node
+	// binary graph if present, text files otherwise
 	printf("LOADING NODE...");
-	fin = fopen(FILE_NODE,"r");
-	int nid;
-	double x,y;
-	while( fscanf(fin, "%d %lf %lf", &nid, &x, &y ) == 3 ){
-		Node node = { x, y };
-		Nodes.push_back(node);
+	if ( ! cgraph_load( FILE_GRAPH, FILE_NODE, FILE_EDGE, cg ) ){
+		exit(1);
+	}
+	// border distances assume every edge goes both ways
+	if ( cg.directed ){
+		printf("%s IS A DIRECTED GRAPH, GTREE NEEDS AN UNDIRECTED ONE\n", FILE_GRAPH);
+		exit(1);
+	}
+
+	// load node
+	Nodes.x.resize( cg.node_count );
+	Nodes.y.resize( cg.node_count );
+	for ( int nid = 0; nid < cg.node_count; nid++ ){
+		Nodes.x[nid] = cg.xy[2 * nid];
+		Nodes.y[nid] = cg.xy[2 * nid + 1];
 	}
-	fclose(fin);
 	printf("COMPLETE. NODE_COUNT=%d\n", (int)Nodes.size());
 
 	// load edge
 	printf("LOADING EDGE...");
-	fin = fopen(FILE_EDGE, "r");
-	int eid;
-	int snid, enid;
-	double weight;
-	int iweight;
-	noe = 0;
-	while( fscanf(fin,"%d %d %d %lf", &eid, &snid, &enid, &weight ) == 4 ){
-		noe ++;
-		iweight = (int) (weight * WEIGHT_INFLATE_FACTOR );
-		Nodes[snid].adjnodes.push_back( enid );
-		Nodes[snid].adjweight.push_back( iweight );
-		Nodes[enid].adjnodes.push_back( snid );
-		Nodes[enid].adjweight.push_back( iweight );
+	vector<int> snids( cg.edge_count ), enids( cg.edge_count ), iweights( cg.edge_count );
+	for ( int eid = 0; eid < cg.edge_count; eid++ ){
+		snids[eid] = cg.edges[eid].snid;
+		enids[eid] = cg.edges[eid].enid;
+		iweights[eid] = (int) (cg.edges[eid].weight * WEIGHT_INFLATE_FACTOR );
 	}
-	fclose(fin);
+	noe = cg.edge_count;
+	cgraph_close( cg );
+	Nodes.set_edges( snids, enids, iweights );
 	printf("COMPLETE.\n");
 }
 
 // transform original data format to that suitable for METIS
-void data_transform_init( set<int> &nset ){
+// input: nset = sorted node id list
+void data_transform_init( vector<int> &nset, MetisGraph &mg ){
 	// nvtxs, ncon
-	nvtxs = nset.size();
-	ncon = 1;
+	mg.nvtxs = nset.size();
+	mg.ncon = 1;
+
+	// size adjacency by the subgraph rather than the whole graph
+	long long degsum = 0;
+	for ( int i = 0; i < nset.size(); i++ ){
+		degsum += Nodes.degree( nset[i] );
+	}
 	
-	xadj = new idx_t[nset.size() + 1];
-	adjncy = new idx_t[noe * 2];
-	adjwgt = new idx_t[noe * 2];
+	mg.xadj = new idx_t[nset.size() + 1];
+	mg.adjncy = new idx_t[degsum];
+	mg.adjwgt = new idx_t[degsum];
 
 
 	int xadj_pos = 1;
@@ -150,48 +196,37 @@ void data_transform_init( set<int> &nset ){
 	int adjncy_pos = 0;
 
 	// xadj, adjncy, adjwgt
-	unordered_map<int,int> nodemap;
-	nodemap.clear();
-
-	xadj[0] = 0;
-	int i = 0;
-	for ( set<int>::iterator it = nset.begin(); it != nset.end(); it++, i++ ){
-		// init node map
-		nodemap[*it] = i;
-
-		int nid = *it;
-		int fanout = Nodes[nid].adjnodes.size();
+	mg.xadj[0] = 0;
+	for ( int i = 0; i < nset.size(); i++ ){
+		int nid = nset[i];
+		int fanout = Nodes.degree( nid );
 		for ( int j = 0; j < fanout; j++ ){
-			int enid = Nodes[nid].adjnodes[j];
-			// ensure edges within
-			if ( nset.find( enid ) != nset.end() ){
+			int enid = Nodes.adj( nid )[j];
+			// ensure edges within, nodes number started by 0
+			vector<int>::iterator it = lower_bound( nset.begin(), nset.end(), enid );
+			if ( it != nset.end() && *it == enid ){
 				xadj_accum ++;
 
-				adjncy[adjncy_pos] = enid;
-				adjwgt[adjncy_pos] = Nodes[nid].adjweight[j];
+				mg.adjncy[adjncy_pos] = it - nset.begin();
+				mg.adjwgt[adjncy_pos] = Nodes.wgt( nid )[j];
 				adjncy_pos ++;
 			}
 		}
-		xadj[xadj_pos++] = xadj_accum;
-	}
-
-	// adjust nodes number started by 0
-	for ( int i = 0; i < adjncy_pos; i++ ){
-		adjncy[i] = nodemap[adjncy[i]];
+		mg.xadj[xadj_pos++] = xadj_accum;
 	}
 
 	// adjwgt -> 1
 	if (ADJWEIGHT_SET_TO_ALL_ONE){
 		for ( int i = 0; i < adjncy_pos; i++ ){
-			adjwgt[i] = 1;
+			mg.adjwgt[i] = 1;
 		}
 	}
 
 	// nparts
-	nparts = PARTITION_PART;
+	mg.nparts = partition_part;
 
 	// part
-	part = new idx_t[nset.size()];
+	mg.part = new idx_t[nset.size()];
 }
 
 void init(){
@@ -199,61 +234,300 @@ void init(){
 	options_setting();
 }
 
-void finalize(){
-    delete xadj;
-    delete adjncy;
-    delete adjwgt;
-    delete part;
+void finalize( MetisGraph &mg ){
+	delete[] mg.xadj;
+	delete[] mg.adjncy;
+	delete[] mg.adjwgt;
+	delete[] mg.part;
 }
 
-// graph partition
-// input: nset = a set of node id
-// output: <node, node belong to partition id>
-unordered_map<int,int> graph_partition( set<int> &nset ){
-	unordered_map<int,int> result;
-
-	// transform data to metis
-	data_transform_init( nset );		
-
-	// partition, result -> part
+void metis_partition( MetisGraph &mg ){
 	// k way partition
 	METIS_PartGraphKway(
-        &nvtxs,
-        &ncon,
-        xadj,
-        adjncy,
+        &mg.nvtxs,
+        &mg.ncon,
+        mg.xadj,
+        mg.adjncy,
         NULL,
         NULL,
-        adjwgt,
-        &nparts,
+        mg.adjwgt,
+        &mg.nparts,
         NULL,
         NULL,
         options,
-        &objval,
-        part
-    );	
+        &mg.objval,
+        mg.part
+    );
+}
+
+// whole-buffer pipe io, false on a closed pipe
+bool pipe_write( int fd, const void *buf, long long len ){
+	const char *p = (const char*)buf;
+	while( len > 0 ){
+		ssize_t n = write( fd, p, len );
+		if ( n <= 0 ) return false;
+		p += n;
+		len -= n;
+	}
+	return true;
+}
+
+bool pipe_read( int fd, void *buf, long long len ){
+	char *p = (char*)buf;
+	while( len > 0 ){
+		ssize_t n = read( fd, p, len );
+		if ( n <= 0 ) return false;
+		p += n;
+		len -= n;
+	}
+	return true;
+}
+
+// helper process loop, partitions subgraphs sent by its worker until the pipe is closed
+void metis_helper_loop( int from, int to ){
+	MetisGraph mg;
+	mg.ncon = 1;
+	mg.nparts = partition_part;
+	while( pipe_read( from, &mg.nvtxs, sizeof(idx_t) ) ){
+		mg.xadj = new idx_t[mg.nvtxs + 1];
+		if ( ! pipe_read( from, mg.xadj, ( mg.nvtxs + 1 ) * sizeof(idx_t) ) ) break;
+		mg.adjncy = new idx_t[mg.xadj[mg.nvtxs]];
+		mg.adjwgt = new idx_t[mg.xadj[mg.nvtxs]];
+		mg.part = new idx_t[mg.nvtxs];
+		if ( ! pipe_read( from, mg.adjncy, mg.xadj[mg.nvtxs] * sizeof(idx_t) ) ) break;
+		if ( ! pipe_read( from, mg.adjwgt, mg.xadj[mg.nvtxs] * sizeof(idx_t) ) ) break;
+		metis_partition( mg );
+		if ( ! pipe_write( to, &mg.objval, sizeof(idx_t) ) ) break;
+		if ( ! pipe_write( to, mg.part, mg.nvtxs * sizeof(idx_t) ) ) break;
+		finalize( mg );
+	}
+}
+
+// fork one helper per build worker, before any worker thread exists
+void metis_helpers_start(){
+	if ( METIS_REENTRANT || build_threads == 1 ) return;
+	for ( int i = 0; i < build_threads; i++ ){
+		int request[2], reply[2];
+		if ( pipe( request ) != 0 || pipe( reply ) != 0 ){
+			printf("CANNOT CREATE PIPE FOR PARTITION HELPER\n");
+			exit(1);
+		}
+		fflush( stdout );
+		pid_t pid = fork();
+		if ( pid < 0 ){
+			printf("CANNOT FORK PARTITION HELPER\n");
+			exit(1);
+		}
+		if ( pid == 0 ){
+			// drop the pipe ends of this and earlier helpers, so they see their pipes close
+			for ( int j = 0; j < metis_helpers.size(); j++ ){
+				close( metis_helpers[j].to );
+				close( metis_helpers[j].from );
+			}
+			close( request[1] );
+			close( reply[0] );
+			metis_helper_loop( request[0], reply[1] );
+			_exit(0);
+		}
+		close( request[0] );
+		close( reply[1] );
+		MetisHelper helper;
+		helper.pid = pid;
+		helper.to = request[1];
+		helper.from = reply[0];
+		metis_helpers.push_back( helper );
+	}
+}
+
+void metis_helpers_stop(){
+	for ( int i = 0; i < metis_helpers.size(); i++ ){
+		close( metis_helpers[i].to );
+		close( metis_helpers[i].from );
+		waitpid( metis_helpers[i].pid, NULL, 0 );
+	}
+	metis_helpers.clear();
+}
+
+// partition on the helper of worker wid
+void metis_partition_remote( MetisGraph &mg, int wid ){
+	MetisHelper &helper = metis_helpers[wid];
+	if ( ! pipe_write( helper.to, &mg.nvtxs, sizeof(idx_t) )
+	  || ! pipe_write( helper.to, mg.xadj, ( mg.nvtxs + 1 ) * sizeof(idx_t) )
+	  || ! pipe_write( helper.to, mg.adjncy, mg.xadj[mg.nvtxs] * sizeof(idx_t) )
+	  || ! pipe_write( helper.to, mg.adjwgt, mg.xadj[mg.nvtxs] * sizeof(idx_t) )
+	  || ! pipe_read( helper.from, &mg.objval, sizeof(idx_t) )
+	  || ! pipe_read( helper.from, mg.part, mg.nvtxs * sizeof(idx_t) ) ){
+		printf("PARTITION HELPER %d FAILED\n", wid);
+		exit(1);
+	}
+}
+
+// graph partition, on build worker wid
+// input: nset = sorted node id list
+// output: partition id of each node, aligned with nset
+vector<int> graph_partition( vector<int> &nset, int wid ){
+	vector<int> result;
+	MetisGraph mg;
+
+	// transform data to metis
+	data_transform_init( nset, mg );
+
+	// partition, result -> part
+	if ( metis_helpers.size() > 0 ) metis_partition_remote( mg, wid );
+	else metis_partition( mg );
 
 	// push to result
-	result.clear();
-	int i = 0;
-	for ( set<int>::iterator it = nset.begin(); it != nset.end(); it++, i++ ){
-		result[*it] = part[i];
+	result.resize( nset.size() );
+	for ( int i = 0; i < nset.size(); i++ ){
+		result[i] = mg.part[i];
 	}
 
 	// finalize
-	finalize();
+	finalize( mg );
 
 	return result;
 }
 
-// init status struct
+// pending subtree of the top-down partitioning
+typedef struct BuildTask{
+	vector<int> nset; // sorted node set, released once partitioned
+	vector<int> borders; // borders of this subtree inside its father
+	vector<struct BuildTask*> children; // empty for leaf
+}BuildTask;
+
+// work-stealing pool over pending subtrees, each worker owns a deque
 typedef struct{
-	int tnid; // tree node id
-	set<int> nset; // node set
-}Status;
+	mutex lock;
+	deque<BuildTask*> tasks;
+}BuildQueue;
+
+vector<BuildQueue*> buildqueues;
+atomic<int> buildpending; // tasks queued or running
+atomic<int> buildqueued; // tasks queued
+// idle workers sleep until tasks are queued or all are done
+mutex buildwait_lock;
+condition_variable buildwait;
+
+// partition one subtree on worker wid, generate its children as new tasks
+void build_task( BuildTask *current, vector<BuildTask*> &generated, int wid ){
+	// check cardinality
+	if ( current->nset.size() <= leaf_cap ){
+		return;
+	}
+
+	// partition
+//	printf("PARTITIONING...SIZE=%d...", (int)current->nset.size() );
+	vector<int> presult = graph_partition( current->nset, wid );
+//	printf("COMPLETE.\n");
+
+	// construct child node set
+	vector< vector<int> > childset( partition_part );
+	for ( int i = 0; i < current->nset.size(); i++ ){
+		childset[presult[i]].push_back( current->nset[i] );
+	}
+	vector<int>().swap( current->nset );
+
+	// generate child tasks
+	for ( int i = 0; i < partition_part; i++ ){
+		BuildTask *child = new BuildTask;
+		child->nset.swap( childset[i] );
+
+		// calculate border nodes
+		for ( int k = 0; k < child->nset.size(); k++ ){
+			int nid = child->nset[k];
+			bool isborder = false;
+			for ( int j = 0; j < Nodes.degree( nid ); j++ ){
+				if ( ! binary_search( child->nset.begin(), child->nset.end(), Nodes.adj( nid )[j] ) ){
+					isborder = true;
+					break;
+				}
+			}
+			if ( isborder ){
+				child->borders.push_back( nid );
+			}
+		}
+
+		current->children.push_back( child );
+		generated.push_back( child );
+	}
+}
+
+// worker loop, pops own tasks LIFO and steals FIFO from others
+void build_worker( int wid ){
+	vector<BuildTask*> generated;
+	while( buildpending.load() > 0 ){
+		BuildTask *current = NULL;
+		for ( int i = 0; i < buildqueues.size() && current == NULL; i++ ){
+			BuildQueue *bq = buildqueues[ (wid + i) % buildqueues.size() ];
+			lock_guard<mutex> guard( bq->lock );
+			if ( bq->tasks.empty() ) continue;
+			if ( i == 0 ){
+				current = bq->tasks.back();
+				bq->tasks.pop_back();
+			}
+			else{
+				current = bq->tasks.front();
+				bq->tasks.pop_front();
+			}
+			buildqueued --;
+		}
+		if ( current == NULL ){
+			unique_lock<mutex> guard( buildwait_lock );
+			buildwait.wait( guard, []{ return buildqueued.load() > 0 || buildpending.load() == 0; } );
+			continue;
+		}
+
+		generated.clear();
+		build_task( current, generated, wid );
+		if ( generated.size() > 0 ){
+			buildpending += generated.size();
+			{
+				lock_guard<mutex> guard( buildqueues[wid]->lock );
+				buildqueues[wid]->tasks.insert( buildqueues[wid]->tasks.end(), generated.begin(), generated.end() );
+			}
+			buildqueued += generated.size();
+		}
+		if ( -- buildpending == 0 || generated.size() > 0 ){
+			lock_guard<mutex> guard( buildwait_lock );
+			buildwait.notify_all();
+		}
+	}
+}
 
 // gtree construction
+// subtrees are partitioned by build_threads workers in any order, then tree node ids
+// are assigned by replaying the serial depth-first order, so the index does not
+// depend on the number of threads
 void build(){
+	// partition
+	BuildTask *roottask = new BuildTask;
+	for ( int i = 0; i < Nodes.size(); i++ ){
+		roottask->nset.push_back(i);
+	}
+
+	buildqueues.clear();
+	for ( int i = 0; i < build_threads; i++ ){
+		buildqueues.push_back( new BuildQueue );
+	}
+	buildqueues[0]->tasks.push_back( roottask );
+	buildpending = 1;
+	buildqueued = 1;
+
+	metis_helpers_start();
+	vector<thread> workers;
+	for ( int i = 1; i < build_threads; i++ ){
+		workers.push_back( thread( build_worker, i ) );
+	}
+	build_worker( 0 );
+	for ( int i = 0; i < workers.size(); i++ ){
+		workers[i].join();
+	}
+	metis_helpers_stop();
+	for ( int i = 0; i < buildqueues.size(); i++ ){
+		delete buildqueues[i];
+	}
+	buildqueues.clear();
+
 	// init root
 	TreeNode root;
 	root.isleaf = false;
@@ -261,97 +535,123 @@ void build(){
 	GTree.push_back(root);
 
 	// init stack
-	stack<Status> buildstack;
-	Status rootstatus;
-	rootstatus.tnid = 0;
-	rootstatus.nset.clear();
-	for ( int i = 0; i < Nodes.size(); i++ ){
-		rootstatus.nset.insert(i);
-	}
-	buildstack.push( rootstatus );
-
-	// start to build
-	unordered_map<int,int> presult;
-	set<int> childset[PARTITION_PART];
-
+	stack< pair<int, BuildTask*> > buildstack;
+	buildstack.push( make_pair( 0, roottask ) );
 
+	// assign tree node ids
+	vector<int> leafof( Nodes.size(), 0 );
+	isborder.assign( Nodes.size(), false );
 	while( buildstack.size() > 0 ){
 		// pop top
-		Status current = buildstack.top();
+		int tnid = buildstack.top().first;
+		BuildTask *current = buildstack.top().second;
 		buildstack.pop();
 
-		// update gtreepath
-		for ( set<int>::iterator it = current.nset.begin(); it != current.nset.end(); it++ ){
-			Nodes[*it].gtreepath.push_back( current.tnid );
-		}
-
-		// check cardinality
-		if ( current.nset.size() <= LEAF_CAP ){
+		if ( current->children.size() == 0 ){
 			// build leaf node
-			GTree[current.tnid].isleaf = true;
-			GTree[current.tnid].leafnodes.clear();
-			for ( set<int>::iterator it = current.nset.begin(); it != current.nset.end(); it++ ){
-				GTree[current.tnid].leafnodes.push_back( *it );
+			GTree[tnid].isleaf = true;
+			GTree[tnid].leafnodes = current->nset;
+
+			for ( int i = 0; i < current->nset.size(); i++ ){
+				leafof[current->nset[i]] = tnid;
 			}
+			delete current;
 			continue;
 		}
 
-		// partition
-//		printf("PARTITIONING...NID=%d...SIZE=%d...", current.tnid, (int)current.nset.size() );
-		presult = graph_partition( current.nset );
-//		printf("COMPLETE.\n");
-
-		// construct child node set
-		for ( int i = 0; i < PARTITION_PART; i++ ){
-			childset[i].clear();
-		}
-		int slot;
-		for ( set<int>::iterator it = current.nset.begin(); it != current.nset.end(); it++ ){
-			slot = presult[*it];
-			childset[slot].insert(*it);
-		}
-
 		// generate child tree nodes
 		int childpos;
-		for ( int i = 0; i < PARTITION_PART; i++ ){
+		for ( int i = 0; i < current->children.size(); i++ ){
 			TreeNode tnode;
 			tnode.isleaf = false;
-			tnode.father = current.tnid;
+			tnode.father = tnid;
 			
 			// insert to GTree first
-            GTree.push_back(tnode);
+			GTree.push_back(tnode);
 			childpos = GTree.size() - 1;
-			GTree[current.tnid].children.push_back( childpos );
-
-			// calculate border nodes
-			GTree[childpos].borders.clear();
-			for ( set<int>::iterator it = childset[i].begin(); it != childset[i].end(); it++ ){
+			GTree[tnid].children.push_back( childpos );
 
-				bool isborder = false;
-				for ( int j = 0; j < Nodes[*it].adjnodes.size(); j++ ){
-					if ( childset[i].find( Nodes[*it].adjnodes[j] ) == childset[i].end() ){
-						isborder = true;
-						break;
-					}
-				}
-				if ( isborder ){
-					GTree[childpos].borders.push_back(*it);
-					// update globally
-					Nodes[*it].isborder = true;
-				}
+			// border nodes
+			GTree[childpos].borders = current->children[i]->borders;
+			for ( int j = 0; j < GTree[childpos].borders.size(); j++ ){
+				// update globally
+				isborder[GTree[childpos].borders[j]] = true;
 			}
 
 			// add to stack
-			Status ongoingstatus;
-			ongoingstatus.tnid = childpos;
-			ongoingstatus.nset = childset[i];
-			buildstack.push(ongoingstatus);
+			buildstack.push( make_pair( childpos, current->children[i] ) );
+		}
+		delete current;
+	}
 
+	// gtreepath = root to leaf, children always come after their father
+	vector<int> depth( GTree.size(), 1 );
+	for ( int i = 1; i < GTree.size(); i++ ){
+		depth[i] = depth[GTree[i].father] + 1;
+	}
+	Nodes.paths.assign( 1, 0 );
+	for ( int i = 0; i < Nodes.size(); i++ ){
+		Nodes.paths.push_back( Nodes.paths.back() + depth[leafof[i]] );
+	}
+	vector<int> path;
+	for ( int i = 0; i < Nodes.size(); i++ ){
+		path.clear();
+		for ( int tn = leafof[i]; tn != -1; tn = GTree[tn].father ){
+			path.push_back(tn);
 		}
+		Nodes.paths.insert( Nodes.paths.end(), path.rbegin(), path.rend() );
+	}
+	Nodes.set_paths();
+}
 
+// renumber vertices in DFS leaf order, so that every tree node covers a contiguous id range
+// and a leaf's vertices, adjacency lists and gtreepaths lie next to each other in memory
+void renumber_vertices(){
+	vertex_order.assign( Nodes.size(), -1 );
+	int next = 0;
+	stack<int> dfs;
+	dfs.push(0);
+	while( dfs.size() > 0 ){
+		int tn = dfs.top();
+		dfs.pop();
+		if ( GTree[tn].isleaf ){
+			for ( int i = 0; i < GTree[tn].leafnodes.size(); i++ ){
+				vertex_order[GTree[tn].leafnodes[i]] = next++;
+			}
+			continue;
+		}
+		for ( int i = GTree[tn].children.size() - 1; i >= 0; i-- ){
+			dfs.push( GTree[tn].children[i] );
+		}
 	}
-	
-	
+
+	Nodes.permute( vertex_order );
+	vector<bool> border( Nodes.size(), false );
+	for ( int i = 0; i < isborder.size(); i++ ){
+		border[vertex_order[i]] = isborder[i];
+	}
+	isborder.swap( border );
+	for ( int i = 0; i < GTree.size(); i++ ){
+		for ( int j = 0; j < GTree[i].borders.size(); j++ ){
+			GTree[i].borders[j] = vertex_order[GTree[i].borders[j]];
+		}
+		sort( GTree[i].borders.begin(), GTree[i].borders.end() );
+		for ( int j = 0; j < GTree[i].leafnodes.size(); j++ ){
+			GTree[i].leafnodes[j] = vertex_order[GTree[i].leafnodes[j]];
+		}
+		sort( GTree[i].leafnodes.begin(), GTree[i].leafnodes.end() );
+	}
+}
+
+// dump vertex order to file, or remove a stale one
+void vertex_order_save(){
+	if ( vertex_order.size() == 0 ){
+		remove( FILE_VERTEX_ORDER );
+		return;
+	}
+	FILE *fout = fopen( FILE_VERTEX_ORDER, "wb" );
+	fwrite( vertex_order.data(), sizeof(int), vertex_order.size(), fout );
+	fclose(fout);
 }
 
 // dump gtree index to file
@@ -385,10 +685,10 @@ void gtree_save(){
 	// FILE_NODES_GTREE_PATH
 	fout = fopen( FILE_NODES_GTREE_PATH, "wb" );
 	for ( int i = 0; i < Nodes.size(); i++ ){
-		int count = Nodes[i].gtreepath.size();
+		IntArray gtreepath = Nodes.gtreepath(i);
+		int count = gtreepath.size();
 		fwrite( &count, sizeof(int), 1, fout );
-		copy( Nodes[i].gtreepath.begin(), Nodes[i].gtreepath.end(), buf );
-		fwrite( buf, sizeof(int), count, fout );
+		fwrite( gtreepath.begin(), sizeof(int), count, fout );
 	}
 	fclose(fout);
 	delete[] buf;
@@ -440,96 +740,43 @@ void gtree_load(){
 	// FILE_NODES_GTREE_PATH
 	int count;
 	fin = fopen( FILE_NODES_GTREE_PATH, "rb" );
-	int pos = 0;
+	// gtreepath table = offsets, then nodes
+	vector<int> pathnodes;
+	Nodes.paths.assign( 1, 0 );
 	while( fread( &count, sizeof(int), 1, fin ) ){
 		fread( buf, sizeof(int), count, fin );
-		// clear gtreepath
-		Nodes[pos].gtreepath.clear();
-		for ( int i = 0; i < count; i++ ){
-			Nodes[pos].gtreepath.push_back( buf[i] );
-		}
-		// pos increase
-		pos ++;
+		pathnodes.insert( pathnodes.end(), buf, buf + count );
+		Nodes.paths.push_back( pathnodes.size() );
 	}
+	Nodes.paths.insert( Nodes.paths.end(), pathnodes.begin(), pathnodes.end() );
+	Nodes.set_paths();
 	fclose(fin);
 	delete[] buf;
 }
 
-// dijkstra search, used for single-source shortest path search WITHIN one gtree leaf node!
-// input: s = source node
-//        cands = candidate node list
-//        graph = search graph(this can be set to subgraph)
-vector<int> dijkstra_candidate( int s, vector<int> &cands, vector<Node> &graph ){
-	// init
-	set<int> todo;
-	todo.clear();
-	todo.insert(cands.begin(), cands.end());
-	
-	unordered_map<int,int> result;
-	result.clear();
-	set<int> visited;
-	visited.clear();
-	unordered_map<int,int> q;
-	q.clear();
-	q[s] = 0;
-
-	// start
-	int min, minpos, adjnode, weight;
-	while( ! todo.empty() && ! q.empty() ){
-		min = -1;
-		for ( unordered_map<int,int>::iterator it = q.begin(); it != q.end(); it ++ ){
-			if ( min == -1 ){
-				minpos = it -> first;
-				min = it -> second;
-			}
-			else{
-				if ( it -> second < min ){
-					min = it -> second;
-					minpos = it -> first;
-				}
-			}
-		}
-
-		// put min to result, add to visited
-		result[minpos] = min;
-		visited.insert( minpos );
-		q.erase(minpos);
-
-		if ( todo.find( minpos ) != todo.end() ){
-			todo.erase( minpos );
-		}
-
-		// expand
-		for ( int i = 0; i < graph[minpos].adjnodes.size(); i++ ){
-			adjnode = graph[minpos].adjnodes[i];
-			if ( visited.find( adjnode ) != visited.end() ){
-				continue;
-			}
-			weight = graph[minpos].adjweight[i];
-
-			if ( q.find(adjnode) != q.end() ){
-				if ( min + weight < q[adjnode] ){
-					q[adjnode] = min + weight;
-				}
-			}
-			else{
-				q[adjnode] = min + weight;
-			}
-		
+// run fn( item, worker ) for every item in [0, n) on build_threads threads
+template<class F>
+void parallel_for( int n, F fn ){
+	atomic<int> next( 0 );
+	auto work = [&]( int wid ){
+		int item;
+		while( ( item = next++ ) < n ){
+			fn( item, wid );
 		}
+	};
+	vector<thread> workers;
+	for ( int i = 1; i < build_threads && i < n; i++ ){
+		workers.push_back( thread( work, i ) );
 	}
-
-	// output
-	vector<int> output;
-	for ( int i = 0; i < cands.size(); i++ ){
-		output.push_back( result[cands[i]] );
+	work( 0 );
+	for ( int i = 0; i < workers.size(); i++ ){
+		workers[i].join();
 	}
-
-	// return
-	return output;
 }
 
 // calculate the distance matrix, algorithm shown in section 5.2 of paper
+// tree nodes on one level own disjoint borders, thus each level runs in two parallel
+// passes: all dijkstra on the graph as left by the level below, then all degenerations
 void hierarchy_shortest_path_calculation(){
 	// level traversal
 	vector< vector<int> > treenodelevel;
@@ -553,98 +800,124 @@ void hierarchy_shortest_path_calculation(){
 	}
 	
 	// bottom up calculation
-	// temp graph
-	vector<Node> graph;
-	graph = Nodes;
-	vector<int> cands;
-	vector<int> result;
-	unordered_map<int, unordered_map<int,int> > vertex_pairs;
-
-	// do dijkstra
-	int s, t, tn, nid, cid, weight;
-	vector<int> tnodes, tweight;
-	set<int> nset;
+	// temp graph, only border adjacency gets degenerated
+	vector<int> allborders;
+	for ( int i = 0; i < Nodes.size(); i++ ){
+		if ( isborder[i] ) allborders.push_back(i);
+	}
+	OverlayGraph graph;
+	graph.init( Nodes, allborders );
+
+	// per thread scratch
+	vector< vector<int> > cands( build_threads ), tnodes( build_threads ), tweight( build_threads );
+	vector< vector<int> > results( build_threads );
+	vector<Dijkstra> dijkstra( build_threads );
+	for ( int i = 0; i < build_threads; i++ ){
+		dijkstra[i].init( graph.size() );
+	}
 
 	for ( int i = treenodelevel.size() - 1; i >= 0; i-- ){
-		for ( int j = 0; j < treenodelevel[i].size(); j++ ){
-			tn = treenodelevel[i][j];
+		vector<int> &level = treenodelevel[i];
+
+		// do dijkstra
+		parallel_for( level.size(), [&]( int j, int wid ){
+			int tn = level[j];
+			vector<int> &cand = cands[wid];
 
-			cands.clear();
+			cand.clear();
 			if ( GTree[tn].isleaf ){
 				// cands = leafnodes
-				cands = GTree[tn].leafnodes;
+				cand = GTree[tn].leafnodes;
 				// union borders = borders;
 				GTree[tn].union_borders = GTree[tn].borders;
 			}
 			else{
-				nset.clear();
+				set<int> nset;
 				for ( int k = 0; k < GTree[tn].children.size(); k++ ){
-					cid = GTree[tn].children[k];
+					int cid = GTree[tn].children[k];
 					nset.insert( GTree[cid].borders.begin(), GTree[cid].borders.end() );
 				}
 				// union borders = cands;
-				
-				cands.clear();
-				for ( set<int>::iterator it = nset.begin(); it != nset.end(); it ++ ){
-					cands.push_back( *it );
-				}
-				GTree[tn].union_borders = cands;
+				cand.assign( nset.begin(), nset.end() );
+				GTree[tn].union_borders = cand;
 			}
 				
-			// start to do min dis
-			vertex_pairs.clear();
-				
 			// for each border, do min dis
-			int cc = 0;
-
+			GTree[tn].mind.clear();
 			for ( int k = 0; k < GTree[tn].union_borders.size(); k++ ){
 				//printf("DIJKSTRA...LEAF=%d BORDER=%d\n", tn, GTree[tn].union_borders[k] );
-				result = dijkstra_candidate( GTree[tn].union_borders[k], cands, graph );
+				vector<int> &result = results[wid];
+				dijkstra[wid].candidate( GTree[tn].union_borders[k], cand, graph, result );
 				//printf("DIJKSTRA...END\n");
 
-				// save to map
-				for ( int p = 0; p < result.size(); p ++ ){
-					GTree[tn].mind.push_back( result[p] );
-					vertex_pairs[GTree[tn].union_borders[k]][cands[p]] = result[p];
-				}
+				// save to matrix
+				GTree[tn].mind.insert( GTree[tn].mind.end(), result.begin(), result.end() );
 			}
+		} );
+
+		// IMPORTANT! after all border finished, degenerate graph
+		parallel_for( level.size(), [&]( int j, int wid ){
+			int tn = level[j];
+			vector<int> &tnode = tnodes[wid], &tweigh = tweight[wid];
+			vector<int> &ub = GTree[tn].union_borders;
+			// row of union_borders, column of cands(leafnodes for leaf, union_borders otherwise)
+			vector<int> &col = GTree[tn].isleaf ? GTree[tn].leafnodes : GTree[tn].union_borders;
+			int s, t, nid, weight, row;
 
-			// IMPORTANT! after all border finished, degenerate graph
-			// first, remove inward edges
 			for ( int k = 0; k < GTree[tn].borders.size(); k++ ){
 				s = GTree[tn].borders[k];
-				tnodes.clear();
-				tweight.clear();
-				for ( int p = 0; p < graph[s].adjnodes.size(); p++ ){
-					nid = graph[s].adjnodes[p];
-					weight = graph[s].adjweight[p];
+				tnode.clear();
+				tweigh.clear();
+				// first, remove inward edges
+				for ( int p = 0; p < graph.degree(s); p++ ){
+					nid = graph.adj(s)[p];
+					weight = graph.wgt(s)[p];
 					// if adj node in same tree node
-
-					if ( graph[nid].gtreepath.size() <= i || graph[nid].gtreepath[i] != tn ){
+					IntArray gtreepath = graph.gtreepath(nid);
+					if ( gtreepath.size() <= i || gtreepath[i] != tn ){
 						// only leave those useful
-						tnodes.push_back(nid);
-						tweight.push_back(weight);
+						tnode.push_back(nid);
+						tweigh.push_back(weight);
 
 					}
 				}
-				// cut it
-				graph[s].adjnodes = tnodes;
-				graph[s].adjweight = tweight;
-			}
-			// second, add inter connected edges
-			for ( int k = 0; k < GTree[tn].borders.size(); k++ ){
+				// second, add inter connected edges
+				row = lower_bound( ub.begin(), ub.end(), s ) - ub.begin();
 				for ( int p = 0; p < GTree[tn].borders.size(); p++ ){
 					if ( k == p ) continue;
-					s = GTree[tn].borders[k];
 					t = GTree[tn].borders[p];
-					graph[s].adjnodes.push_back( t );
-					graph[s].adjweight.push_back( vertex_pairs[s][t] );
+					tnode.push_back( t );
+					tweigh.push_back( GTree[tn].mind[ row * col.size() + ( lower_bound( col.begin(), col.end(), t ) - col.begin() ) ] );
 				}
+				// cut it
+				graph.replace( s, tnode, tweigh );
 			}
-		}
+		} );
 	}
 }
 
+// in-leaf all-pairs distances, a dijkstra on the whole graph from every vertex of each leaf
+// output: mind[tn] = leafnodes x leafnodes of leaf tn, empty for other tree nodes
+void leaf_distance_calculation( vector< vector<int> > &mind ){
+	vector<int> leaves;
+	for ( int i = 0; i < GTree.size(); i++ ){
+		if ( GTree[i].isleaf ) leaves.push_back( i );
+	}
+	mind.assign( GTree.size(), vector<int>() );
+	vector< vector<int> > results( build_threads );
+	vector<Dijkstra> dijkstra( build_threads );
+	for ( int i = 0; i < build_threads; i++ ){
+		dijkstra[i].init( Nodes.size() );
+	}
+	parallel_for( leaves.size(), [&]( int j, int wid ){
+		vector<int> &cand = GTree[leaves[j]].leafnodes;
+		for ( int k = 0; k < cand.size(); k++ ){
+			dijkstra[wid].candidate( cand[k], cand, Nodes, results[wid] );
+			mind[leaves[j]].insert( mind[leaves[j]].end(), results[wid].begin(), results[wid].end() );
+		}
+	} );
+}
+
 // dump distance matrix into file
 void hierarchy_shortest_path_save(){
 	FILE* fout = fopen( FILE_ONTREE_MIND, "wb" );
@@ -697,7 +970,45 @@ void hierarchy_shortest_path_load(){
 	fclose(fin);
 }
 
-int main(){
+int main( int argc, char **argv ){
+	// options
+	int opt;
+	while( ( opt = getopt( argc, argv, "t:cf:l:ra" ) ) != -1 ){
+		switch( opt ){
+			case 't':
+				build_threads = atoi(optarg);
+				if ( build_threads < 1 ) build_threads = 1;
+				break;
+			case 'c':
+				mind_compress = true;
+				break;
+			case 'f':
+				partition_part = atoi(optarg);
+				break;
+			case 'l':
+				leaf_cap = atoi(optarg);
+				break;
+			case 'r':
+				renumber = true;
+				break;
+			case 'a':
+				leaf_dist = true;
+				break;
+			default:
+				printf("USAGE: %s [-t threads] [-c] [-f fanout] [-l leaf_cap] [-r] [-a]\n", argv[0]);
+				printf("	-c compress distance matrices of the single-file index\n");
+				printf("	-f gtree fanout, default %d\n", PARTITION_PART);
+				printf("	-l gtree leaf node capacity, default %d\n", LEAF_CAP);
+				printf("	-r renumber vertices in DFS leaf order, gtree_query maps ids back\n");
+				printf("	-a also write in-leaf all-pairs distances(%s), gtree_query uses them instead of in-leaf dijkstra\n", FILE_LEAF_DIST);
+				return 1;
+		}
+	}
+	if ( partition_part < 2 || leaf_cap < 1 ){
+		printf("FANOUT MUST BE >= 2, LEAF_CAP >= 1\n");
+		return 1;
+	}
+
 	// init
 	TIME_TICK_START
 	init();
@@ -705,11 +1016,21 @@ int main(){
 	TIME_TICK_PRINT("INIT")
 
 	// gtree_build
+	printf("BUILD THREADS=%d FANOUT=%d LEAF_CAP=%d\n", build_threads, partition_part, leaf_cap);
 	TIME_TICK_START
 	build();
 	TIME_TICK_END
 	TIME_TICK_PRINT("BUILD")
 
+	// renumber
+	if ( renumber ){
+		TIME_TICK_START
+		renumber_vertices();
+		TIME_TICK_END
+		TIME_TICK_PRINT("RENUMBER")
+	}
+	vertex_order_save();
+
 	// dump gtree
 	gtree_save();
 	
@@ -722,5 +1043,29 @@ int main(){
 	// dump distance matrix
 	hierarchy_shortest_path_save();
 
+	// dump single-file index
+	vector<char> image;
+	index_build( GTree, Nodes, vertex_order, partition_part, leaf_cap, mind_compress, image );
+	if ( ! index_save( FILE_GTREE_INDEX, image ) ){
+		printf("CANNOT WRITE %s\n", FILE_GTREE_INDEX);
+		return 1;
+	}
+
+	// in-leaf all-pairs distances, or remove stale ones of another index
+	if ( ! leaf_dist ){
+		remove( FILE_LEAF_DIST );
+		return 0;
+	}
+	TIME_TICK_START
+	vector< vector<int> > leafmind;
+	leaf_distance_calculation( leafmind );
+	leafdist_build( leafmind, Nodes.size(), leaf_cap, leafdist_stamp( GTree, Nodes ), image );
+	TIME_TICK_END
+	TIME_TICK_PRINT("LEAF_DIST")
+	if ( ! index_save( FILE_LEAF_DIST, image ) ){
+		printf("CANNOT WRITE %s\n", FILE_LEAF_DIST);
+		return 1;
+	}
+
 	return 0;
 }
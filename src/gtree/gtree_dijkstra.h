@@ -0,0 +1,163 @@
+// dijkstra kernel shared by gtree_build and gtree_query
+// indexed binary heap with decrease key, dense distance arrays reset by epoch stamp,
+// search stops as soon as all candidates are settled
+#ifndef GTREE_DIJKSTRA_H
+#define GTREE_DIJKSTRA_H
+
+#include<vector>
+using namespace std;
+
+struct Dijkstra{
+	vector<int> dist; // tentative distance, valid if stamp == epoch
+	vector<int> pos; // position in heap, -1 if settled
+	vector<unsigned> stamp; // epoch the vertex was reached in
+	vector<unsigned> candstamp; // epoch the vertex was a candidate in
+	vector<int> heap; // vertex ids, heap ordered by dist
+	unsigned epoch;
+
+	Dijkstra(){ epoch = 0; }
+
+	// n = |vertices|, must be called before search
+	void init( int n ){
+		dist.assign( n, 0 );
+		pos.assign( n, -1 );
+		stamp.assign( n, 0 );
+		candstamp.assign( n, 0 );
+		heap.clear();
+		epoch = 0;
+	}
+
+	// start a new search, invalidates all distances in O(1)
+	void next_epoch(){
+		epoch ++;
+		if ( epoch == 0 ){
+			// wrap around, reset stamps once every 2^32 searches
+			stamp.assign( stamp.size(), 0 );
+			candstamp.assign( candstamp.size(), 0 );
+			epoch = 1;
+		}
+		heap.clear();
+	}
+
+	void sift_up( int i ){
+		int v = heap[i];
+		while( i > 0 ){
+			int p = ( i - 1 ) >> 1;
+			if ( dist[heap[p]] <= dist[v] ) break;
+			heap[i] = heap[p];
+			pos[heap[i]] = i;
+			i = p;
+		}
+		heap[i] = v;
+		pos[v] = i;
+	}
+
+	void sift_down( int i ){
+		int v = heap[i], n = heap.size();
+		while( true ){
+			int c = ( i << 1 ) + 1;
+			if ( c >= n ) break;
+			if ( c + 1 < n && dist[heap[c+1]] < dist[heap[c]] ) c++;
+			if ( dist[v] <= dist[heap[c]] ) break;
+			heap[i] = heap[c];
+			pos[heap[i]] = i;
+			i = c;
+		}
+		heap[i] = v;
+		pos[v] = i;
+	}
+
+	// insert v or decrease its key
+	void relax( int v, int d ){
+		if ( stamp[v] != epoch ){
+			stamp[v] = epoch;
+			dist[v] = d;
+			heap.push_back(v);
+			sift_up( heap.size() - 1 );
+		}
+		else if ( pos[v] != -1 && d < dist[v] ){
+			dist[v] = d;
+			sift_up( pos[v] );
+		}
+	}
+
+	// remove and settle heap top
+	int pop(){
+		int v = heap[0];
+		pos[v] = -1;
+		int last = heap.back();
+		heap.pop_back();
+		if ( heap.size() > 0 ){
+			heap[0] = last;
+			sift_down( 0 );
+		}
+		return v;
+	}
+
+	// multi-source search, settles every vertex not farther than radius from any source
+	// distances are read by settled() until the next search
+	template<class G>
+	void bounded( vector<int> &sources, G &graph, int radius ){
+		next_epoch();
+		for ( int i = 0; i < sources.size(); i++ ){
+			relax( sources[i], 0 );
+		}
+		int min, minpos;
+		while( heap.size() > 0 && dist[heap[0]] <= radius ){
+			minpos = pop();
+			min = dist[minpos];
+			const int *adj = graph.adj( minpos ), *wgt = graph.wgt( minpos );
+			for ( int i = 0, deg = graph.degree( minpos ); i < deg; i++ ){
+				relax( adj[i], min + wgt[i] );
+			}
+		}
+	}
+
+	// distance of v in the last bounded() search, -1 if not settled
+	int settled( int v ) const {
+		return stamp[v] == epoch && pos[v] == -1 ? dist[v] : -1;
+	}
+
+	// single-source shortest path from s to candidate nodes
+	// input: s = source node
+	//        cands = candidate node list
+	//        graph = search graph(Graph or OverlayGraph)
+	// output: distance of each candidate, aligned with cands (0 if not reachable)
+	template<class G>
+	void candidate( int s, vector<int> &cands, G &graph, vector<int> &output ){
+		next_epoch();
+
+		int todo = 0;
+		for ( int i = 0; i < cands.size(); i++ ){
+			if ( candstamp[cands[i]] != epoch ){
+				candstamp[cands[i]] = epoch;
+				todo ++;
+			}
+		}
+
+		relax( s, 0 );
+		int min, minpos, adjnode;
+		while( todo > 0 && heap.size() > 0 ){
+			minpos = pop();
+			min = dist[minpos];
+			if ( candstamp[minpos] == epoch ){
+				todo --;
+			}
+
+			// expand
+			const int *adj = graph.adj( minpos ), *wgt = graph.wgt( minpos );
+			for ( int i = 0, deg = graph.degree( minpos ); i < deg; i++ ){
+				adjnode = adj[i];
+				relax( adjnode, min + wgt[i] );
+			}
+		}
+
+		// output
+		output.resize( cands.size() );
+		for ( int i = 0; i < cands.size(); i++ ){
+			output[i] = stamp[cands[i]] == epoch && pos[cands[i]] == -1 ? dist[cands[i]] : 0;
+		}
+	}
+};
+
+#endif
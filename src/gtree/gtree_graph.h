@@ -0,0 +1,164 @@
+// road network in compressed sparse row form, shared by gtree_build and gtree_query
+#ifndef GTREE_GRAPH_H
+#define GTREE_GRAPH_H
+
+#include<vector>
+using namespace std;
+
+// read-only view of a contiguous int array
+struct IntArray{
+	const int *p;
+	int n;
+
+	IntArray(){ p = NULL; n = 0; }
+	IntArray( const int *_p, int _n ){ p = _p; n = _n; }
+	IntArray( const vector<int> &v ){ p = v.data(); n = v.size(); }
+
+	int size() const { return n; }
+	bool empty() const { return n == 0; }
+	int operator[]( int i ) const { return p[i]; }
+	int back() const { return p[n-1]; }
+	const int* begin() const { return p; }
+	const int* end() const { return p + n; }
+};
+
+struct Graph{
+	vector<double> x, y; // coordinates
+	vector<int> offset; // adjacency of v is [offset[v], offset[v+1])
+	vector<int> adjnodes;
+	vector<int> adjweight;
+	const int *pathoffset; // gtreepath of v is [pathoffset[v], pathoffset[v+1]) of pathnodes
+	const int *pathnodes; // this is used to do sub-graph locating
+	vector<int> paths; // gtreepath table owned by the graph, n + 1 offsets then nodes
+
+	Graph(){ pathoffset = NULL; pathnodes = NULL; }
+
+	int size() const { return x.size(); }
+	int degree( int v ) const { return offset[v+1] - offset[v]; }
+	const int* adj( int v ) const { return adjnodes.data() + offset[v]; }
+	const int* wgt( int v ) const { return adjweight.data() + offset[v]; }
+	IntArray gtreepath( int v ) const { return IntArray( pathnodes + pathoffset[v], pathoffset[v+1] - pathoffset[v] ); }
+
+	// use the owned gtreepath table, or one kept elsewhere(e.g. a mapped index)
+	void set_paths(){ set_paths( paths.data(), paths.data() + size() + 1 ); }
+	void set_paths( const int *offsets, const int *nodes ){ pathoffset = offsets; pathnodes = nodes; }
+
+	// renumber vertices, order[v] = new id of v
+	// adjacency lists keep their order, an owned gtreepath table is moved along
+	void permute( const vector<int> &order ){
+		int n = size();
+		vector<int> inverse( n );
+		for ( int v = 0; v < n; v++ ){
+			inverse[order[v]] = v;
+		}
+		vector<double> nx( n ), ny( n );
+		vector<int> noffset( n + 1, 0 ), nadj( adjnodes.size() ), nwgt( adjweight.size() );
+		for ( int i = 0; i < n; i++ ){
+			int v = inverse[i];
+			nx[i] = x[v];
+			ny[i] = y[v];
+			noffset[i + 1] = noffset[i] + degree(v);
+			for ( int p = 0; p < degree(v); p++ ){
+				nadj[noffset[i] + p] = order[adj(v)[p]];
+				nwgt[noffset[i] + p] = wgt(v)[p];
+			}
+		}
+		x.swap( nx );
+		y.swap( ny );
+		offset.swap( noffset );
+		adjnodes.swap( nadj );
+		adjweight.swap( nwgt );
+
+		if ( paths.size() > 0 ){
+			vector<int> npaths( 1, 0 ), nodes;
+			for ( int i = 0; i < n; i++ ){
+				IntArray gtreepath = this->gtreepath( inverse[i] );
+				nodes.insert( nodes.end(), gtreepath.begin(), gtreepath.end() );
+				npaths.push_back( nodes.size() );
+			}
+			npaths.insert( npaths.end(), nodes.begin(), nodes.end() );
+			paths.swap( npaths );
+			set_paths();
+		}
+	}
+
+	// set weight of undirected edge u-v(every copy of it)
+	// output: old weight, -1 if there is no such edge
+	int set_weight( int u, int v, int w ){
+		int old = -1;
+		for ( int i = offset[u]; i < offset[u+1]; i++ ){
+			if ( adjnodes[i] != v ) continue;
+			old = adjweight[i];
+			adjweight[i] = w;
+		}
+		for ( int i = offset[v]; i < offset[v+1]; i++ ){
+			if ( adjnodes[i] == u ) adjweight[i] = w;
+		}
+		return old;
+	}
+
+	// build adjacency from an undirected edge list, each vertex keeps its edges in list order
+	void set_edges( vector<int> &snids, vector<int> &enids, vector<int> &weights ){
+		int n = size();
+		offset.assign( n + 1, 0 );
+		for ( int i = 0; i < snids.size(); i++ ){
+			offset[snids[i] + 1] ++;
+			offset[enids[i] + 1] ++;
+		}
+		for ( int i = 0; i < n; i++ ){
+			offset[i + 1] += offset[i];
+		}
+		adjnodes.resize( offset[n] );
+		adjweight.resize( offset[n] );
+		vector<int> fill( offset.begin(), offset.end() - 1 );
+		for ( int i = 0; i < snids.size(); i++ ){
+			adjnodes[fill[snids[i]]] = enids[i];
+			adjweight[fill[snids[i]]++] = weights[i];
+			adjnodes[fill[enids[i]]] = snids[i];
+			adjweight[fill[enids[i]]++] = weights[i];
+		}
+	}
+};
+
+// graph whose adjacency lists can be replaced per vertex without copying the base graph,
+// used to degenerate border edges while computing distance matrices
+struct OverlayGraph{
+	const Graph *base;
+	vector<int> slot; // index into ovnodes/ovweight, -1 to use base adjacency
+	vector< vector<int> > ovnodes;
+	vector< vector<int> > ovweight;
+
+	// vertices = the only vertices replace() may be called on
+	void init( const Graph &g, vector<int> &vertices ){
+		base = &g;
+		slot.assign( g.size(), -1 );
+		ovnodes.clear();
+		ovweight.clear();
+		for ( int i = 0; i < vertices.size(); i++ ){
+			if ( slot[vertices[i]] != -1 ) continue;
+			slot[vertices[i]] = ovnodes.size();
+			ovnodes.push_back( vector<int>( base->adj( vertices[i] ), base->adj( vertices[i] ) + base->degree( vertices[i] ) ) );
+			ovweight.push_back( vector<int>( base->wgt( vertices[i] ), base->wgt( vertices[i] ) + base->degree( vertices[i] ) ) );
+		}
+	}
+
+	int size() const { return base->size(); }
+	int degree( int v ) const { return slot[v] == -1 ? base->degree(v) : ovnodes[slot[v]].size(); }
+	const int* adj( int v ) const { return slot[v] == -1 ? base->adj(v) : ovnodes[slot[v]].data(); }
+	const int* wgt( int v ) const { return slot[v] == -1 ? base->wgt(v) : ovweight[slot[v]].data(); }
+	IntArray gtreepath( int v ) const { return base->gtreepath(v); }
+
+	// distinct vertices may be replaced concurrently
+	void replace( int v, vector<int> &nodes, vector<int> &weights ){
+		ovnodes[slot[v]] = nodes;
+		ovweight[slot[v]] = weights;
+	}
+
+	// back to the base adjacency of v
+	void restore( int v ){
+		ovnodes[slot[v]].assign( base->adj(v), base->adj(v) + base->degree(v) );
+		ovweight[slot[v]].assign( base->wgt(v), base->wgt(v) + base->degree(v) );
+	}
+};
+
+#endif
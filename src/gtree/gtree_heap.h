@@ -0,0 +1,86 @@
+// 4-ary min-heap of search entries by their int dis field, the best-first queue of gtree_query
+// half as deep as a binary heap and the 4 children of a node are adjacent in memory. entries of a
+// leaf are appended together and enter the heap at once(heapify_from()), by a linear-time heapify
+// if they are many compared to the heap. pushes, pops and sift moves are counted until reset
+#ifndef GTREE_HEAP_H
+#define GTREE_HEAP_H
+
+#include<vector>
+using namespace std;
+
+template<class E>
+struct QuadHeap{
+	vector<E> a;
+	long long pushes, pops, moves; // counters
+
+	QuadHeap(){ reset_counters(); }
+
+	void reset_counters(){ pushes = 0; pops = 0; moves = 0; }
+
+	int size() const { return a.size(); }
+	bool empty() const { return a.size() == 0; }
+	void clear(){ a.clear(); }
+	const E& top() const { return a[0]; }
+
+	void sift_up( int i ){
+		E e = a[i];
+		while( i > 0 ){
+			int p = ( i - 1 ) >> 2;
+			if ( a[p].dis <= e.dis ) break;
+			a[i] = a[p];
+			i = p;
+			moves ++;
+		}
+		a[i] = e;
+	}
+
+	// put e at hole i and move it down
+	void sift_down( int i, const E &e ){
+		int n = a.size(), c, end, best;
+		while( ( c = 4 * i + 1 ) < n ){
+			best = c;
+			end = c + 4 < n ? c + 4 : n;
+			for ( c++; c < end; c++ ){
+				if ( a[c].dis < a[best].dis ) best = c;
+			}
+			if ( e.dis <= a[best].dis ) break;
+			a[i] = a[best];
+			i = best;
+			moves ++;
+		}
+		a[i] = e;
+	}
+
+	void push( const E &e ){
+		a.push_back( e );
+		sift_up( a.size() - 1 );
+		pushes ++;
+	}
+
+	void pop(){
+		pops ++;
+		E last = a.back();
+		a.pop_back();
+		if ( a.size() > 0 ) sift_down( 0, last );
+	}
+
+	// bulk insertion: append() entries, then heapify_from() the size before the first of them
+	void append( const E &e ){ a.push_back( e ); }
+
+	void heapify_from( int first ){
+		int n = a.size();
+		pushes += n - first;
+		if ( ( n - first ) * 4 < n ){
+			for ( int i = first; i < n; i++ ){
+				sift_up( i );
+			}
+			return;
+		}
+		for ( int i = ( n - 2 ) >> 2; i >= 0; i-- ){
+			E e = a[i];
+			sift_down( i, e );
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,412 @@
+// single-file gtree index, laid out to be mmap-ed and used in place by gtree_query
+//
+// [IndexHeader][IndexTreeNode * tree_count][gtreepath offsets * (node_count + 1)][gtreepath nodes]
+// [vertex order * node_count, if renumbered][pool]
+// every section and every distance matrix starts at a multiple of INDEX_ALIGN bytes,
+// other arrays of the int pool at a multiple of 16 bytes
+//
+// a renumbered index(gtree_build -r) uses vertex ids in DFS leaf order, vertex order maps
+// the ids of the graph files to them
+//
+// distance matrices are either plain ints, or compressed row by row: each row stores its
+// minimum as base and every entry as (entry - base) in just enough bits for the row
+#ifndef GTREE_INDEX_H
+#define GTREE_INDEX_H
+
+#include<stdio.h>
+#include<string.h>
+#include<vector>
+#include<unordered_map>
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include"gtree_graph.h"
+using namespace std;
+
+#define INDEX_MAGIC 0x58444947 // "GIDX"
+#define INDEX_VERSION 3
+#define INDEX_ALIGN 64
+
+typedef struct{
+	int magic;
+	int version;
+	int node_count; // |vertices|
+	int tree_count; // |tree nodes|
+	int fanout; // PARTITION_PART of the build
+	int leaf_cap; // LEAF_CAP of the build
+	int mind_compressed; // distance matrices are compressed
+	int renumbered; // vertex ids are in DFS leaf order, see order_offset
+	long long tree_offset; // byte offset of each section
+	long long pathoffset_offset;
+	long long pathnodes_offset;
+	long long order_offset; // new id of each graph file id, 0 if not renumbered
+	long long pool_offset;
+	long long file_size;
+}IndexHeader;
+
+// arrays are int offsets into the pool
+typedef struct{
+	long long borders;
+	long long children;
+	long long leafnodes;
+	long long union_borders;
+	long long mind; // row by row of union_borders, packed bits if compressed
+	long long mind_rows; // MatrixRow of each row if compressed
+	long long up_pos; // position of each border in father's union_borders
+	long long current_pos; // position of each border in own union_borders
+	long long count_mind; // ints in pool
+	int count_borders; // also count of up_pos and current_pos
+	int count_children;
+	int count_leafnodes;
+	int count_union_borders;
+	int isleaf;
+	int father;
+}IndexTreeNode;
+
+// row of a compressed distance matrix
+typedef struct{
+	int base; // row minimum
+	int bits; // bits per entry
+	long long offset; // byte offset of the row in packed data
+}MatrixRow;
+
+// distance matrix of a tree node, plain or compressed
+struct DistMatrix{
+	const int *data; // row-major ints, or packed rows if compressed
+	const MatrixRow *rows; // NULL if plain
+	int cols;
+
+	DistMatrix(){ data = NULL; rows = NULL; cols = 0; }
+
+	int at( int row, int col ) const {
+		if ( rows == NULL ) return data[ (long long)row * cols + col ];
+		const MatrixRow &r = rows[row];
+		long long bit = (long long)col * r.bits;
+		unsigned long long w;
+		memcpy( &w, (const char*)data + r.offset + ( bit >> 3 ), sizeof(w) );
+		return r.base + (int)( ( w >> ( bit & 7 ) ) & ( ( 1ULL << r.bits ) - 1 ) );
+	}
+};
+
+// compress a rows * cols matrix into packed rows
+// output: row table and packed data, padded so that every entry can be read by one 8-byte load
+inline void matrix_compress( const int *mind, int rows, int cols, vector<MatrixRow> &table, vector<unsigned char> &packed ){
+	table.resize( rows );
+	packed.clear();
+	for ( int i = 0; i < rows; i++ ){
+		const int *row = mind + (long long)i * cols;
+		int min = row[0], max = row[0];
+		for ( int j = 1; j < cols; j++ ){
+			if ( row[j] < min ) min = row[j];
+			if ( row[j] > max ) max = row[j];
+		}
+		int bits = 0;
+		while( bits < 32 && ( (unsigned)( max - min ) >> bits ) != 0 ) bits++;
+		table[i].base = min;
+		table[i].bits = bits;
+		table[i].offset = packed.size();
+
+		long long start = packed.size();
+		packed.resize( start + ( (long long)cols * bits + 7 ) / 8, 0 );
+		for ( int j = 0; j < cols; j++ ){
+			unsigned long long v = (unsigned)( row[j] - min );
+			long long bit = (long long)j * bits;
+			for ( int b = 0; b < bits; b++, bit++ ){
+				if ( ( v >> b ) & 1 ){
+					packed[start + ( bit >> 3 )] |= 1 << ( bit & 7 );
+				}
+			}
+		}
+	}
+	packed.resize( packed.size() + sizeof(unsigned long long), 0 );
+}
+
+inline long long index_align( long long offset ){
+	return ( offset + INDEX_ALIGN - 1 ) / INDEX_ALIGN * INDEX_ALIGN;
+}
+
+// serialize tree(borders, children, isleaf, leafnodes, father, union_borders, mind),
+// gtreepath of graph and the vertex order(empty if not renumbered) into image
+template<class T>
+void index_build( vector<T> &tree, const Graph &graph, const vector<int> &order, int fanout, int leaf_cap, bool compress, vector<char> &image ){
+	IndexHeader header;
+	memset( &header, 0, sizeof(header) );
+	header.magic = INDEX_MAGIC;
+	header.version = INDEX_VERSION;
+	header.node_count = graph.size();
+	header.tree_count = tree.size();
+	header.fanout = fanout;
+	header.leaf_cap = leaf_cap;
+	header.mind_compressed = compress;
+	header.renumbered = order.size() > 0;
+
+	// sections
+	int pathcount = graph.pathoffset[graph.size()];
+	header.tree_offset = index_align( sizeof(IndexHeader) );
+	header.pathoffset_offset = index_align( header.tree_offset + sizeof(IndexTreeNode) * tree.size() );
+	header.pathnodes_offset = index_align( header.pathoffset_offset + sizeof(int) * ( graph.size() + 1 ) );
+	header.order_offset = header.renumbered ? index_align( header.pathnodes_offset + sizeof(int) * pathcount ) : 0;
+	header.pool_offset = header.renumbered ? index_align( header.order_offset + sizeof(int) * order.size() ) : index_align( header.pathnodes_offset + sizeof(int) * pathcount );
+
+	// compress
+	vector< vector<MatrixRow> > tables( compress ? tree.size() : 0 );
+	vector< vector<unsigned char> > packeds( compress ? tree.size() : 0 );
+	for ( int i = 0; compress && i < tree.size(); i++ ){
+		int rows = tree[i].union_borders.size();
+		if ( rows == 0 || tree[i].mind.size() == 0 ) continue;
+		matrix_compress( &tree[i].mind[0], rows, tree[i].mind.size() / rows, tables[i], packeds[i] );
+	}
+
+	// lay out pool
+	vector<IndexTreeNode> records( tree.size() );
+	long long pool = 0;
+	const long long alignint = INDEX_ALIGN / sizeof(int);
+	#define POOL_PLACE( field, count, align ) r.field = pool; pool = ( pool + (count) + (align) - 1 ) / (align) * (align);
+	for ( int i = 0; i < tree.size(); i++ ){
+		IndexTreeNode &r = records[i];
+		memset( &r, 0, sizeof(r) );
+		r.count_borders = tree[i].borders.size();
+		r.count_children = tree[i].children.size();
+		r.count_leafnodes = tree[i].leafnodes.size();
+		r.count_union_borders = tree[i].union_borders.size();
+		r.count_mind = compress ? ( packeds[i].size() + sizeof(int) - 1 ) / sizeof(int) : tree[i].mind.size();
+		r.isleaf = tree[i].isleaf;
+		r.father = tree[i].father;
+		POOL_PLACE( borders, r.count_borders, 4 )
+		POOL_PLACE( children, r.count_children, 4 )
+		POOL_PLACE( leafnodes, r.count_leafnodes, 4 )
+		POOL_PLACE( union_borders, r.count_union_borders, 4 )
+		POOL_PLACE( up_pos, r.count_borders, 4 )
+		POOL_PLACE( current_pos, r.count_borders, alignint )
+		POOL_PLACE( mind, r.count_mind, alignint )
+		if ( compress ){
+			POOL_PLACE( mind_rows, tables[i].size() * sizeof(MatrixRow) / sizeof(int), 4 )
+		}
+	}
+	#undef POOL_PLACE
+	header.file_size = header.pool_offset + sizeof(int) * pool;
+
+	// fill
+	image.assign( header.file_size, 0 );
+	char *base = &image[0];
+	memcpy( base, &header, sizeof(header) );
+	memcpy( base + header.tree_offset, records.data(), sizeof(IndexTreeNode) * records.size() );
+	memcpy( base + header.pathoffset_offset, graph.pathoffset, sizeof(int) * ( graph.size() + 1 ) );
+	memcpy( base + header.pathnodes_offset, graph.pathnodes, sizeof(int) * pathcount );
+	if ( header.renumbered ){
+		memcpy( base + header.order_offset, order.data(), sizeof(int) * order.size() );
+	}
+
+	int *ints = (int*)( base + header.pool_offset );
+	unordered_map<int,int> pos_map;
+	for ( int i = 0; i < tree.size(); i++ ){
+		IndexTreeNode &r = records[i];
+		copy( tree[i].borders.begin(), tree[i].borders.end(), ints + r.borders );
+		copy( tree[i].children.begin(), tree[i].children.end(), ints + r.children );
+		copy( tree[i].leafnodes.begin(), tree[i].leafnodes.end(), ints + r.leafnodes );
+		copy( tree[i].union_borders.begin(), tree[i].union_borders.end(), ints + r.union_borders );
+		if ( compress ){
+			memcpy( ints + r.mind, packeds[i].data(), packeds[i].size() );
+			memcpy( ints + r.mind_rows, tables[i].data(), tables[i].size() * sizeof(MatrixRow) );
+		}
+		else{
+			copy( tree[i].mind.begin(), tree[i].mind.end(), ints + r.mind );
+		}
+
+		// current_pos & up_pos(used for quickly locating parent & child nodes)
+		pos_map.clear();
+		for ( int j = 0; j < tree[i].union_borders.size(); j++ ){
+			pos_map[tree[i].union_borders[j]] = j;
+		}
+		for ( int j = 0; j < tree[i].borders.size(); j++ ){
+			ints[r.current_pos + j] = pos_map[tree[i].borders[j]];
+		}
+		if ( tree[i].father == -1 ) continue;
+		pos_map.clear();
+		for ( int j = 0; j < tree[tree[i].father].union_borders.size(); j++ ){
+			pos_map[tree[tree[i].father].union_borders[j]] = j;
+		}
+		for ( int j = 0; j < tree[i].borders.size(); j++ ){
+			ints[r.up_pos + j] = pos_map[tree[i].borders[j]];
+		}
+	}
+}
+
+// dump image to file
+inline bool index_save( const char *file, vector<char> &image ){
+	FILE *fout = fopen( file, "wb" );
+	if ( fout == NULL ) return false;
+	bool ok = fwrite( &image[0], 1, image.size(), fout ) == image.size();
+	fclose(fout);
+	return ok;
+}
+
+// whether count units from offset lie within limit units
+inline bool index_fits( long long offset, long long count, long long limit ){
+	return offset >= 0 && count >= 0 && offset <= limit && count <= limit - offset;
+}
+
+// whether every one of n ids lies in [0, limit)
+inline bool index_ids( const int *ids, long long n, int limit ){
+	for ( long long i = 0; i < n; i++ ){
+		if ( ids[i] < 0 || ids[i] >= limit ) return false;
+	}
+	return true;
+}
+
+// validate an image of len bytes: the header, every section and every array of every tree node
+// must lie within the file and the ids they hold within their range, so that a truncated or
+// corrupted file is never read out of bounds
+// output: the header, NULL and the reason printed if broken
+inline const IndexHeader* index_check( const char *base, long long len, int node_count ){
+	const IndexHeader *header = (const IndexHeader*)base;
+	if ( len < sizeof(IndexHeader) || header->magic != INDEX_MAGIC ){
+		printf("INDEX: BAD MAGIC\n");
+		return NULL;
+	}
+	if ( header->version != INDEX_VERSION ){
+		printf("INDEX: VERSION %d, EXPECTED %d\n", header->version, INDEX_VERSION);
+		return NULL;
+	}
+	if ( header->file_size != len ){
+		printf("INDEX: SIZE %lld, EXPECTED %lld\n", len, header->file_size);
+		return NULL;
+	}
+	if ( header->node_count != node_count ){
+		printf("INDEX: NODE_COUNT %d, GRAPH HAS %d\n", header->node_count, node_count);
+		return NULL;
+	}
+
+	// sections
+	if ( header->tree_count <= 0
+	  || header->tree_offset % INDEX_ALIGN != 0 || ! index_fits( header->tree_offset, header->tree_count * (long long)sizeof(IndexTreeNode), len )
+	  || header->pathoffset_offset % INDEX_ALIGN != 0 || ! index_fits( header->pathoffset_offset, ( node_count + 1LL ) * sizeof(int), len )
+	  || header->pathnodes_offset % INDEX_ALIGN != 0 || ! index_fits( header->pathnodes_offset, 0, len )
+	  || ( header->renumbered && ( header->order_offset % INDEX_ALIGN != 0 || ! index_fits( header->order_offset, node_count * (long long)sizeof(int), len ) ) )
+	  || header->pool_offset % INDEX_ALIGN != 0 || ! index_fits( header->pool_offset, 0, len ) ){
+		printf("INDEX: SECTION OUT OF FILE\n");
+		return NULL;
+	}
+
+	// gtreepaths
+	const int *pathoffset = (const int*)( base + header->pathoffset_offset );
+	const int *pathnodes = (const int*)( base + header->pathnodes_offset );
+	bool ok = pathoffset[0] == 0 && index_fits( header->pathnodes_offset, pathoffset[node_count] * (long long)sizeof(int), len );
+	for ( int v = 0; ok && v < node_count; v++ ){
+		ok = pathoffset[v] < pathoffset[v + 1];
+	}
+	if ( ! ok || ! index_ids( pathnodes, pathoffset[node_count], header->tree_count ) ){
+		printf("INDEX: GTREEPATHS OUT OF RANGE\n");
+		return NULL;
+	}
+	if ( header->renumbered && ! index_ids( (const int*)( base + header->order_offset ), node_count, node_count ) ){
+		printf("INDEX: VERTEX ORDER OUT OF RANGE\n");
+		return NULL;
+	}
+
+	// tree nodes, arrays count ints of the pool
+	const IndexTreeNode *records = (const IndexTreeNode*)( base + header->tree_offset );
+	const int *ints = (const int*)( base + header->pool_offset );
+	long long pool = ( len - header->pool_offset ) / sizeof(int);
+	for ( int i = 0; i < header->tree_count; i++ ){
+		const IndexTreeNode &r = records[i];
+		long long rows = r.count_union_borders, cols = rows == 0 ? 0 : ( r.isleaf ? r.count_leafnodes : r.count_union_borders );
+		ok = index_fits( r.borders, r.count_borders, pool ) && index_fits( r.children, r.count_children, pool )
+		  && index_fits( r.leafnodes, r.count_leafnodes, pool ) && index_fits( r.union_borders, r.count_union_borders, pool )
+		  && index_fits( r.up_pos, r.count_borders, pool ) && index_fits( r.current_pos, r.count_borders, pool )
+		  && index_fits( r.mind, r.count_mind, pool ) && r.father >= -1 && r.father < header->tree_count;
+		if ( ok && ! header->mind_compressed ){
+			ok = rows * cols <= r.count_mind;
+		}
+		if ( ok && header->mind_compressed ){
+			// every entry is read by one 8-byte load within the packed rows
+			ok = r.mind_rows % 2 == 0 && index_fits( r.mind_rows, rows * sizeof(MatrixRow) / sizeof(int), pool );
+			const MatrixRow *table = (const MatrixRow*)( ints + r.mind_rows );
+			for ( long long k = 0; ok && k < rows; k++ ){
+				ok = table[k].bits >= 0 && table[k].bits <= 32
+				  && index_fits( table[k].offset, ( cols * table[k].bits + 7 ) / 8 + sizeof(unsigned long long), r.count_mind * sizeof(int) );
+			}
+		}
+		if ( ok ){
+			ok = index_ids( ints + r.borders, r.count_borders, node_count ) && index_ids( ints + r.children, r.count_children, header->tree_count )
+			  && index_ids( ints + r.leafnodes, r.count_leafnodes, node_count ) && index_ids( ints + r.union_borders, r.count_union_borders, node_count )
+			  && index_ids( ints + r.current_pos, r.count_borders, r.count_union_borders );
+		}
+		if ( ok && r.father != -1 ){
+			ok = index_ids( ints + r.up_pos, r.count_borders, records[r.father].count_union_borders );
+		}
+		if ( ! ok ){
+			printf("INDEX: TREE NODE %d OUT OF RANGE\n", i);
+			return NULL;
+		}
+	}
+	return header;
+}
+
+// map index file read-only, pages are shared by all processes using the same index
+// writable = map copy-on-write instead, pages written(e.g. by index updates) become private
+//            and are never written back to the file
+// output: base address, NULL if failed
+inline const char* index_map( const char *file, long long &len, bool writable = false ){
+	int fd = open( file, O_RDONLY );
+	if ( fd < 0 ) return NULL;
+	struct stat st;
+	if ( fstat( fd, &st ) != 0 || st.st_size == 0 ){
+		close(fd);
+		return NULL;
+	}
+	len = st.st_size;
+	void *base = mmap( NULL, len, writable ? PROT_READ | PROT_WRITE : PROT_READ, writable ? MAP_PRIVATE : MAP_SHARED, fd, 0 );
+	close(fd);
+	if ( base == MAP_FAILED ) return NULL;
+	return (const char*)base;
+}
+
+// point tree nodes and gtreepath of graph into a checked image
+// tree node type T holds IntArray fields
+template<class T>
+void index_attach( const char *base, vector<T> &tree, Graph &graph ){
+	const IndexHeader *header = (const IndexHeader*)base;
+	const IndexTreeNode *records = (const IndexTreeNode*)( base + header->tree_offset );
+	const int *ints = (const int*)( base + header->pool_offset );
+
+	tree.resize( header->tree_count );
+	for ( int i = 0; i < header->tree_count; i++ ){
+		const IndexTreeNode &r = records[i];
+		tree[i].borders = IntArray( ints + r.borders, r.count_borders );
+		tree[i].children = IntArray( ints + r.children, r.count_children );
+		tree[i].isleaf = r.isleaf;
+		tree[i].leafnodes = IntArray( ints + r.leafnodes, r.count_leafnodes );
+		tree[i].father = r.father;
+		tree[i].union_borders = IntArray( ints + r.union_borders, r.count_union_borders );
+		tree[i].mind.data = ints + r.mind;
+		tree[i].mind.rows = header->mind_compressed ? (const MatrixRow*)( ints + r.mind_rows ) : NULL;
+		tree[i].mind.cols = r.count_union_borders == 0 ? 0 : ( r.isleaf ? r.count_leafnodes : r.count_union_borders );
+		tree[i].up_pos = IntArray( ints + r.up_pos, r.count_borders );
+		tree[i].current_pos = IntArray( ints + r.current_pos, r.count_borders );
+	}
+	graph.set_paths( (const int*)( base + header->pathoffset_offset ), (const int*)( base + header->pathnodes_offset ) );
+}
+
+// vertex order of an image, new id of each graph file id, NULL if not renumbered
+inline const int* index_order( const char *base ){
+	const IndexHeader *header = (const IndexHeader*)base;
+	return header->renumbered ? (const int*)( base + header->order_offset ) : NULL;
+}
+
+// bytes taken by distance matrices of an image
+inline long long index_mind_bytes( const char *base ){
+	const IndexHeader *header = (const IndexHeader*)base;
+	const IndexTreeNode *records = (const IndexTreeNode*)( base + header->tree_offset );
+	long long bytes = 0;
+	for ( int i = 0; i < header->tree_count; i++ ){
+		bytes += records[i].count_mind * sizeof(int);
+		if ( header->mind_compressed ){
+			bytes += records[i].count_union_borders * sizeof(MatrixRow);
+		}
+	}
+	return bytes;
+}
+
+#endif
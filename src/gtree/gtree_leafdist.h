@@ -0,0 +1,209 @@
+// in-leaf all-pairs distances, an optional file written by gtree_build -a. gtree_query reads the
+// distances inside the query's own leaf from it instead of running a dijkstra there
+//
+// [LeafDistHeader][offset of each tree node's matrix * tree_count][matrices]
+// the matrix of a leaf is leafnodes x leafnodes network distances in the whole graph(a path may
+// leave the leaf and come back through its borders), row-major by position in leafnodes, an offset
+// counts ints from the first matrix, -1 for non-leaf tree nodes
+// positions are those of the index built with it, so the file goes with that index only,
+// which the stamp(leafdist_stamp()) of that index and graph checks
+#ifndef GTREE_LEAFDIST_H
+#define GTREE_LEAFDIST_H
+
+#include<stdio.h>
+#include<string.h>
+#include<vector>
+#include"gtree_graph.h"
+#include"gtree_dijkstra.h"
+using namespace std;
+
+#define LEAFDIST_MAGIC 0x4446454c // "LEFD"
+#define LEAFDIST_VERSION 1
+
+typedef struct{
+	int magic;
+	int version;
+	int node_count; // |vertices| of the index
+	int tree_count; // |tree nodes| of the index
+	int leaf_cap;
+	int reserved;
+	unsigned long long stamp; // leafdist_stamp() of the index and graph
+	long long file_size;
+}LeafDistHeader;
+
+struct LeafDist{
+	const long long *offset; // NULL if not loaded
+	const int *data;
+
+	LeafDist(){ offset = NULL; data = NULL; }
+
+	bool loaded() const { return offset != NULL; }
+
+	// distances from the i-th vertex of leaf tn to each vertex of it
+	const int* row( int tn, int i, int n ) const { return data + offset[tn] + (long long)i * n; }
+};
+
+// vertices of each leaf in tree order(partition and numbering) and the edge weights
+// tree node type T holds leafnodes and isleaf
+template<class T>
+unsigned long long leafdist_stamp( vector<T> &tree, const Graph &graph ){
+	// FNV-1a over leaf vertices
+	unsigned long long stamp = 14695981039346656037ULL;
+	for ( int i = 0; i < tree.size(); i++ ){
+		if ( ! tree[i].isleaf ) continue;
+		for ( int j = 0; j < tree[i].leafnodes.size(); j++ ){
+			stamp = ( stamp ^ (unsigned)tree[i].leafnodes[j] ) * 1099511628211ULL;
+		}
+	}
+	// edges in any adjacency order
+	unsigned long long edges = 0;
+	for ( int v = 0; v < graph.size(); v++ ){
+		for ( int j = 0; j < graph.degree( v ); j++ ){
+			unsigned long long e = ( (unsigned long long)v << 32 | (unsigned)graph.adj( v )[j] ) * 0x9e3779b97f4a7c15ULL;
+			e = ( e ^ ( e >> 29 ) ^ (unsigned)graph.wgt( v )[j] ) * 0xbf58476d1ce4e5b9ULL;
+			edges += e ^ ( e >> 32 );
+		}
+	}
+	return stamp ^ edges;
+}
+
+// serialize matrices, mind[tn] is leafnodes x leafnodes of leaf tn, empty for other tree nodes
+inline void leafdist_build( vector< vector<int> > &mind, int node_count, int leaf_cap, unsigned long long stamp, vector<char> &image ){
+	LeafDistHeader header;
+	memset( &header, 0, sizeof(header) );
+	header.magic = LEAFDIST_MAGIC;
+	header.version = LEAFDIST_VERSION;
+	header.node_count = node_count;
+	header.tree_count = mind.size();
+	header.leaf_cap = leaf_cap;
+	header.stamp = stamp;
+	vector<long long> offset( mind.size(), -1 );
+	long long ints = 0;
+	for ( int i = 0; i < mind.size(); i++ ){
+		if ( mind[i].size() == 0 ) continue;
+		offset[i] = ints;
+		ints += mind[i].size();
+	}
+	header.file_size = sizeof(header) + offset.size() * sizeof(long long) + ints * sizeof(int);
+
+	image.resize( header.file_size );
+	char *p = &image[0];
+	memcpy( p, &header, sizeof(header) );
+	p += sizeof(header);
+	memcpy( p, offset.data(), offset.size() * sizeof(long long) );
+	p += offset.size() * sizeof(long long);
+	for ( int i = 0; i < mind.size(); i++ ){
+		memcpy( p, mind[i].data(), mind[i].size() * sizeof(int) );
+		p += mind[i].size() * sizeof(int);
+	}
+}
+
+// point view at an image of len bytes, checking it against the loaded tree and graph
+// tree node type T holds IntArray leafnodes and isleaf
+// output: false and the reason printed if the image does not fit
+template<class T>
+bool leafdist_attach( const char *base, long long len, vector<T> &tree, const Graph &graph, LeafDist &view ){
+	const LeafDistHeader *header = (const LeafDistHeader*)base;
+	if ( len < (long long)sizeof(LeafDistHeader) || header->magic != LEAFDIST_MAGIC ){
+		printf("LEAF DISTANCES: BROKEN FILE\n");
+		return false;
+	}
+	if ( header->version != LEAFDIST_VERSION ){
+		printf("LEAF DISTANCES: VERSION %d, EXPECTED %d\n", header->version, LEAFDIST_VERSION);
+		return false;
+	}
+	if ( header->file_size != len ){
+		printf("LEAF DISTANCES: BROKEN FILE\n");
+		return false;
+	}
+	if ( header->node_count != graph.size() || header->tree_count != tree.size() || header->stamp != leafdist_stamp( tree, graph ) ){
+		printf("LEAF DISTANCES: BUILT FOR ANOTHER INDEX\n");
+		return false;
+	}
+	const long long *offset = (const long long*)( base + sizeof(LeafDistHeader) );
+	long long ints = ( len - sizeof(LeafDistHeader) - tree.size() * sizeof(long long) ) / sizeof(int);
+	for ( int i = 0; i < tree.size(); i++ ){
+		long long n = tree[i].leafnodes.size();
+		if ( tree[i].isleaf && ( offset[i] < 0 || offset[i] + n * n > ints ) ){
+			printf("LEAF DISTANCES: BUILT FOR ANOTHER INDEX\n");
+			return false;
+		}
+	}
+	view.offset = offset;
+	view.data = (const int*)( offset + tree.size() );
+	return true;
+}
+
+// largest entry of all matrices
+template<class T>
+int leafdist_max( const LeafDist &view, vector<T> &tree ){
+	int max = 0;
+	for ( int tn = 0; tn < tree.size(); tn++ ){
+		if ( ! tree[tn].isleaf ) continue;
+		long long n = tree[tn].leafnodes.size();
+		const int *m = view.row( tn, 0, n );
+		for ( long long i = 0; i < n * n; i++ ){
+			if ( m[i] > max ) max = m[i];
+		}
+	}
+	return max;
+}
+
+// mark the entries edge weight changes may affect, by the test of gtree_update.h: near holds m()
+// of a group of changed edges, w is their smallest weight, entry (u, v) can only change if
+// m(u) + w + m(v) <= entry. a matrix is symmetric, only its upper half is marked
+// marks = a flag per entry of each leaf, row-major as the matrices
+template<class T>
+void leafdist_mark( const LeafDist &view, vector<T> &tree, const Dijkstra &near, int w, vector< vector<char> > &marks ){
+	int ms, mt, n;
+	for ( int tn = 0; tn < tree.size(); tn++ ){
+		if ( ! tree[tn].isleaf ) continue;
+		n = tree[tn].leafnodes.size();
+		for ( int i = 0; i < n; i++ ){
+			ms = near.settled( tree[tn].leafnodes[i] );
+			if ( ms == -1 ) continue;
+			const int *row = view.row( tn, i, n );
+			for ( int c = i + 1; c < n; c++ ){
+				mt = near.settled( tree[tn].leafnodes[c] );
+				if ( mt != -1 && (long long)ms + w + mt <= row[c] ){
+					marks[tn][(long long)i * n + c] = 1;
+				}
+			}
+		}
+	}
+}
+
+// recompute the marked entries on graph(the new weights, undirected, so each pair is searched once)
+// and clear their marks, the image must be mapped writable
+// output: number of recomputed entries
+template<class T>
+int leafdist_recompute( LeafDist &view, vector<T> &tree, Graph &graph, vector< vector<char> > &marks, Dijkstra &engine ){
+	vector<int> cols, cands, result;
+	int entries = 0, n;
+	for ( int tn = 0; tn < tree.size(); tn++ ){
+		if ( ! tree[tn].isleaf ) continue;
+		n = tree[tn].leafnodes.size();
+		for ( int i = 0; i < n; i++ ){
+			char *mark = &marks[tn][(long long)i * n];
+			cols.clear();
+			cands.clear();
+			for ( int c = i + 1; c < n; c++ ){
+				if ( ! mark[c] ) continue;
+				mark[c] = 0;
+				cols.push_back( c );
+				cands.push_back( tree[tn].leafnodes[c] );
+			}
+			if ( cols.size() == 0 ) continue;
+			engine.candidate( tree[tn].leafnodes[i], cands, graph, result );
+			int *row = (int*)view.row( tn, i, n );
+			for ( int c = 0; c < cols.size(); c++ ){
+				row[cols[c]] = result[c];
+				((int*)view.row( tn, cols[c], n ))[i] = result[c];
+			}
+			entries += 2 * cols.size();
+		}
+	}
+	return entries;
+}
+
+#endif
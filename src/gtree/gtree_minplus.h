@@ -0,0 +1,101 @@
+// min-plus kernels of knn queries: min over k of a[k] + row[pos[k]], row being one row of a
+// plain distance matrix and a[] the border distances of a tree node. the widest kernel the cpu
+// supports is picked at run time by minplus_select(), the others stay callable for comparison
+#ifndef GTREE_MINPLUS_H
+#define GTREE_MINPLUS_H
+
+#include<string.h>
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#define MINPLUS_X86
+#include<immintrin.h>
+#endif
+
+// pos == NULL reads row[k], a consecutive run of columns
+// n > 0
+typedef int (*MinPlusKernel)( const int *a, const int *row, const int *pos, int n );
+
+inline int minplus_scalar( const int *a, const int *row, const int *pos, int n ){
+	int min = a[0] + ( pos == NULL ? row[0] : row[pos[0]] );
+	for ( int k = 1; k < n; k++ ){
+		int dis = a[k] + ( pos == NULL ? row[k] : row[pos[k]] );
+		if ( dis < min ) min = dis;
+	}
+	return min;
+}
+
+#ifdef MINPLUS_X86
+__attribute__((target("avx2")))
+inline int minplus_avx2( const int *a, const int *row, const int *pos, int n ){
+	if ( n < 8 ) return minplus_scalar( a, row, pos, n );
+	__m256i vmin = _mm256_set1_epi32( 0x7fffffff ), va, vr;
+	int k = 0;
+	for ( ; k + 8 <= n; k += 8 ){
+		va = _mm256_loadu_si256( (const __m256i*)( a + k ) );
+		if ( pos == NULL ) vr = _mm256_loadu_si256( (const __m256i*)( row + k ) );
+		else vr = _mm256_i32gather_epi32( row, _mm256_loadu_si256( (const __m256i*)( pos + k ) ), 4 );
+		vmin = _mm256_min_epi32( vmin, _mm256_add_epi32( va, vr ) );
+	}
+	__m128i m = _mm_min_epi32( _mm256_castsi256_si128( vmin ), _mm256_extracti128_si256( vmin, 1 ) );
+	m = _mm_min_epi32( m, _mm_shuffle_epi32( m, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+	m = _mm_min_epi32( m, _mm_shuffle_epi32( m, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+	int min = _mm_cvtsi128_si32( m );
+	if ( k < n ){
+		int rest = minplus_scalar( a + k, pos == NULL ? row + k : row, pos == NULL ? NULL : pos + k, n - k );
+		if ( rest < min ) min = rest;
+	}
+	return min;
+}
+
+__attribute__((target("avx512f")))
+inline int minplus_avx512( const int *a, const int *row, const int *pos, int n ){
+	if ( n < 16 ) return minplus_avx2( a, row, pos, n );
+	// full-mask forms with explicit sources, the plain gather/min/reduce intrinsics take an
+	// undefined source register that gcc 12 -Wall reports as maybe-uninitialized
+	__m512i vmin = _mm512_set1_epi32( 0x7fffffff ), zero = _mm512_setzero_si512(), va, vr;
+	int k = 0;
+	for ( ; k + 16 <= n; k += 16 ){
+		va = _mm512_loadu_si512( a + k );
+		if ( pos == NULL ) vr = _mm512_loadu_si512( row + k );
+		else vr = _mm512_mask_i32gather_epi32( zero, 0xffff, _mm512_loadu_si512( pos + k ), row, 4 );
+		vmin = _mm512_mask_min_epi32( vmin, 0xffff, vmin, _mm512_add_epi32( va, vr ) );
+	}
+	// the tail as one masked step
+	if ( k < n ){
+		__mmask16 mask = ( 1 << ( n - k ) ) - 1;
+		va = _mm512_maskz_loadu_epi32( mask, a + k );
+		if ( pos == NULL ) vr = _mm512_maskz_loadu_epi32( mask, row + k );
+		else vr = _mm512_mask_i32gather_epi32( zero, mask, _mm512_maskz_loadu_epi32( mask, pos + k ), row, 4 );
+		vmin = _mm512_mask_min_epi32( vmin, mask, vmin, _mm512_add_epi32( va, vr ) );
+	}
+	__m256i low = _mm512_mask_extracti64x4_epi64( _mm256_setzero_si256(), 0xff, vmin, 0 );
+	__m256i half = _mm256_min_epi32( low, _mm512_mask_extracti64x4_epi64( _mm256_setzero_si256(), 0xff, vmin, 1 ) );
+	__m128i m = _mm_min_epi32( _mm256_castsi256_si128( half ), _mm256_extracti128_si256( half, 1 ) );
+	m = _mm_min_epi32( m, _mm_shuffle_epi32( m, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+	m = _mm_min_epi32( m, _mm_shuffle_epi32( m, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+	return _mm_cvtsi128_si32( m );
+}
+#endif
+
+static MinPlusKernel minplus = minplus_scalar;
+
+// select a kernel by name("scalar", "avx2", "avx512"), NULL for the best supported one
+// output: name of the kernel in use, NULL if the named one is unknown or not supported(nothing changes then)
+inline const char* minplus_select( const char *name ){
+	const char *names[] = { "avx512", "avx2", "scalar" };
+	MinPlusKernel kernels[] = { NULL, NULL, minplus_scalar };
+#ifdef MINPLUS_X86
+	__builtin_cpu_init();
+	if ( __builtin_cpu_supports( "avx512f" ) ) kernels[0] = minplus_avx512;
+	if ( __builtin_cpu_supports( "avx2" ) ) kernels[1] = minplus_avx2;
+#endif
+	for ( int i = 0; i < 3; i++ ){
+		if ( kernels[i] == NULL ) continue;
+		if ( name == NULL || strcmp( name, names[i] ) == 0 ){
+			minplus = kernels[i];
+			return names[i];
+		}
+	}
+	return NULL;
+}
+
+#endif
@@ -13,8 +13,23 @@
 #include<stack>
 #include<algorithm>
 #include<sys/time.h>
+#include<time.h>
+#include<unistd.h>
+#include<thread>
+#include<atomic>
+#include<string>
+#include<climits>
 using namespace std;
 
+#include"gtree_graph.h"
+#include"gtree_dijkstra.h"
+#include"gtree_index.h"
+#include"gtree_update.h"
+#include"gtree_minplus.h"
+#include"gtree_leafdist.h"
+#include"gtree_heap.h"
+#include"../cgraph/cgraph.h"
+
 // MACRO for timing
 struct timeval tv;
 long long ts, te;
@@ -23,50 +38,62 @@ long long ts, te;
 #define TIME_TICK_PRINT(T) printf("%s RESULT: %lld (0.01MS)\r\n", (#T), te - ts );
 // ----------
 
+// benchmark queries are drawn with this seed, so runs are comparable
+#define BENCH_SEED 20171217
+
 #define FILE_NODE "cal.cnode"
 #define FILE_EDGE "cal.cedge"
+#define FILE_GRAPH "cal.cgraph" // binary graph of cgraph_convert, used instead of the two above if present
 // set all edge weight to 1(unweighted graph)
 #define ADJWEIGHT_SET_TO_ALL_ONE true
 // we assume edge weight is integer, thus (input edge) * WEIGHT_INFLATE_FACTOR = (our edge weight)
 #define WEIGHT_INFLATE_FACTOR 100000
-// gtree fanout
-#define PARTITION_PART 4
-// gtree leaf node capacity = tau(in paper)
-#define LEAF_CAP 32
 // gtree index disk storage
 #define FILE_NODES_GTREE_PATH "cal.paths"
 #define FILE_GTREE 			  "cal.gtree"
 #define FILE_ONTREE_MIND	  "cal.minds"
+#define FILE_GTREE_INDEX	  "cal.gidx" // single-file index, used instead of the three above if present
+#define FILE_VERTEX_ORDER	  "cal.order" // new id of each vertex, if the split files are renumbered
+#define FILE_LEAF_DIST		  "cal.leafd" // in-leaf all-pairs distances(gtree_build -a), used if present
 // input
 #define FILE_OBJECT "cal.object"
 
-typedef struct{
-	double x,y;
-	vector<int> adjnodes;
-	vector<int> adjweight;
-	bool isborder;
-	vector<int> gtreepath; // this is used to do sub-graph locating
-}Node;
-
+// tree node as stored in the split index files, only used while loading them
 typedef struct{
 	vector<int> borders;
 	vector<int> children;
 	bool isleaf;
 	vector<int> leafnodes;
 	int father;
+	vector<int> union_borders;
+	vector<int> mind;
+}TreeNodeFile;
+
+// index arrays point into the (mapped) index image
+typedef struct{
+	IntArray borders;
+	IntArray children;
+	bool isleaf;
+	IntArray leafnodes;
+	int father;
 // ----- min dis -----
-	vector<int> union_borders; // for non leaf node	
-	vector<int> mind; // min dis, row by row of union_borders
-// ----- for pre query init, OCCURENCE LIST in paper -----
-	vector<int> nonleafinvlist;
-	vector<int> leafinvlist;
-	vector<int> up_pos;
-	vector<int> current_pos;
+	IntArray union_borders; // for non leaf node	
+	DistMatrix mind; // min dis, row by row of union_borders
+// ----- OCCURENCE LIST in paper is kept per object set, see ObjectSet -----
+	IntArray up_pos;
+	IntArray current_pos;
 }TreeNode;
 
 int noe; // number of edges
-vector<Node> Nodes;
+Graph Nodes;
 vector<TreeNode> GTree;
+vector<char> indeximage; // index image built from the split files
+IndexUpdater<TreeNode> updater; // edge weight changes
+LeafDist leafdist; // of FILE_LEAF_DIST, if loaded
+// renumbered index(gtree_build -r): the index and Nodes use new ids, input and output use
+// the ids of the graph files. both empty if not renumbered
+vector<int> vertex_new; // file id -> new id
+vector<int> vertex_old; // new id -> file id
 
 // use for metis
 // idx_t = int64_t / real_t = double
@@ -102,37 +129,39 @@ void options_setting(){
 
 // input init
 void init_input(){
-	FILE *fin;
+	CGraph cg;
 
-	// load node
+	// binary graph if present, text files otherwise
 	printf("LOADING NODE...");
-	fin = fopen(FILE_NODE,"r");
-	int nid;
-	double x,y;
-	while( fscanf(fin, "%d %lf %lf", &nid, &x, &y ) == 3 ){
-		Node node = { x, y };
-		Nodes.push_back(node);
+	if ( ! cgraph_load( FILE_GRAPH, FILE_NODE, FILE_EDGE, cg ) ){
+		exit(1);
+	}
+	// border distances assume every edge goes both ways
+	if ( cg.directed ){
+		printf("%s IS A DIRECTED GRAPH, GTREE NEEDS AN UNDIRECTED ONE\n", FILE_GRAPH);
+		exit(1);
+	}
+
+	// load node
+	Nodes.x.resize( cg.node_count );
+	Nodes.y.resize( cg.node_count );
+	for ( int nid = 0; nid < cg.node_count; nid++ ){
+		Nodes.x[nid] = cg.xy[2 * nid];
+		Nodes.y[nid] = cg.xy[2 * nid + 1];
 	}
-	fclose(fin);
 	printf("COMPLETE. NODE_COUNT=%d\n", (int)Nodes.size());
 
 	// load edge
 	printf("LOADING EDGE...");
-	fin = fopen(FILE_EDGE, "r");
-	int eid;
-	int snid, enid;
-	double weight;
-	int iweight;
-	noe = 0;
-	while( fscanf(fin,"%d %d %d %lf", &eid, &snid, &enid, &weight ) == 4 ){
-		noe ++;
-		iweight = (int) (weight * WEIGHT_INFLATE_FACTOR );
-		Nodes[snid].adjnodes.push_back( enid );
-		Nodes[snid].adjweight.push_back( iweight );
-		Nodes[enid].adjnodes.push_back( snid );
-		Nodes[enid].adjweight.push_back( iweight );
+	vector<int> snids( cg.edge_count ), enids( cg.edge_count ), iweights( cg.edge_count );
+	for ( int eid = 0; eid < cg.edge_count; eid++ ){
+		snids[eid] = cg.edges[eid].snid;
+		enids[eid] = cg.edges[eid].enid;
+		iweights[eid] = (int) (cg.edges[eid].weight * WEIGHT_INFLATE_FACTOR );
 	}
-	fclose(fin);
+	noe = cg.edge_count;
+	cgraph_close( cg );
+	Nodes.set_edges( snids, enids, iweights );
 	printf("COMPLETE.\n");
 }
 
@@ -149,7 +178,7 @@ void finalize(){
 }
 
 // load gtree index from file
-void gtree_load(){
+void gtree_load( vector<TreeNodeFile> &GTree ){
 	// FILE_GTREE
 	FILE *fin = fopen( FILE_GTREE, "rb" );
 	int *buf = new int[ Nodes.size() ];
@@ -161,7 +190,7 @@ void gtree_load(){
 	GTree.clear();
 
 	while( fread( &count_borders, sizeof(int), 1, fin ) ){
-		TreeNode tn;
+		TreeNodeFile tn;
 		// borders
 		tn.borders.clear();
 		fread( buf, sizeof(int), count_borders, fin );
@@ -194,97 +223,22 @@ void gtree_load(){
 	// FILE_NODES_GTREE_PATH
 	int count;
 	fin = fopen( FILE_NODES_GTREE_PATH, "rb" );
-	int pos = 0;
+	// gtreepath table = offsets, then nodes
+	vector<int> pathnodes;
+	Nodes.paths.assign( 1, 0 );
 	while( fread( &count, sizeof(int), 1, fin ) ){
 		fread( buf, sizeof(int), count, fin );
-		// clear gtreepath
-		Nodes[pos].gtreepath.clear();
-		for ( int i = 0; i < count; i++ ){
-			Nodes[pos].gtreepath.push_back( buf[i] );
-		}
-		// pos increase
-		pos ++;
+		pathnodes.insert( pathnodes.end(), buf, buf + count );
+		Nodes.paths.push_back( pathnodes.size() );
 	}
+	Nodes.paths.insert( Nodes.paths.end(), pathnodes.begin(), pathnodes.end() );
+	Nodes.set_paths();
 	fclose(fin);
 	delete[] buf;
 }
 
-// dijkstra search, used for single-source shortest path search WITHIN one gtree leaf node!
-// input: s = source node
-//        cands = candidate node list
-//        graph = search graph(this can be set to subgraph)
-vector<int> dijkstra_candidate( int s, vector<int> &cands, vector<Node> &graph ){
-	// init
-	set<int> todo;
-	todo.clear();
-	todo.insert(cands.begin(), cands.end());
-	
-	unordered_map<int,int> result;
-	result.clear();
-	set<int> visited;
-	visited.clear();
-	unordered_map<int,int> q;
-	q.clear();
-	q[s] = 0;
-
-	// start
-	int min, minpos, adjnode, weight;
-	while( ! todo.empty() && ! q.empty() ){
-		min = -1;
-		for ( unordered_map<int,int>::iterator it = q.begin(); it != q.end(); it ++ ){
-			if ( min == -1 ){
-				minpos = it -> first;
-				min = it -> second;
-			}
-			else{
-				if ( it -> second < min ){
-					min = it -> second;
-					minpos = it -> first;
-				}
-			}
-		}
-
-		// put min to result, add to visited
-		result[minpos] = min;
-		visited.insert( minpos );
-		q.erase(minpos);
-
-		if ( todo.find( minpos ) != todo.end() ){
-			todo.erase( minpos );
-		}
-
-		// expand
-		for ( int i = 0; i < graph[minpos].adjnodes.size(); i++ ){
-			adjnode = graph[minpos].adjnodes[i];
-			if ( visited.find( adjnode ) != visited.end() ){
-				continue;
-			}
-			weight = graph[minpos].adjweight[i];
-
-			if ( q.find(adjnode) != q.end() ){
-				if ( min + weight < q[adjnode] ){
-					q[adjnode] = min + weight;
-				}
-			}
-			else{
-				q[adjnode] = min + weight;
-			}
-		
-		}
-	}
-
-	// output
-	vector<int> output;
-	for ( int i = 0; i < cands.size(); i++ ){
-		output.push_back( result[cands[i]] );
-	}
-
-	// return
-	return output;
-}
-
 // load distance matrix from file
-void hierarchy_shortest_path_load(){
+void hierarchy_shortest_path_load( vector<TreeNodeFile> &GTree ){
 	FILE* fin = fopen( FILE_ONTREE_MIND, "rb" );
 	int* buf;
 	int count, pos = 0;
@@ -311,72 +265,241 @@ void hierarchy_shortest_path_load(){
 	fclose(fin);
 }
 
-// before query, we have to set OCCURENCE LIST etc.
-// this is done only ONCE for a given set of objects.
-void pre_query(){
-	// first clear all
-	for ( int i = 0; i < GTree.size(); i++ ){
-		GTree[i].nonleafinvlist.clear();
-		GTree[i].leafinvlist.clear();
+// load vertex order of renumbered split files
+// output: empty if there is none
+vector<int> vertex_order_load(){
+	vector<int> order;
+	FILE *fin = fopen( FILE_VERTEX_ORDER, "rb" );
+	if ( fin == NULL ) return order;
+	order.resize( Nodes.size() );
+	if ( fread( order.data(), sizeof(int), order.size(), fin ) != order.size() ){
+		order.clear();
 	}
-	
-	// read object list
-	vector<int> o;
-	o.clear();
+	fclose(fin);
+	return order;
+}
+
+inline int to_new( int v ){ return vertex_new.size() > 0 ? vertex_new[v] : v; }
+inline int to_old( int v ){ return vertex_old.size() > 0 ? vertex_old[v] : v; }
+
+// position of vertex v in leafnodes of leaf tn, leaves cover a contiguous id range if renumbered
+inline int leaf_pos( int tn, int v ){
+	if ( vertex_new.size() > 0 ) return v - GTree[tn].leafnodes[0];
+	return lower_bound( GTree[tn].leafnodes.begin(), GTree[tn].leafnodes.end(), v ) - GTree[tn].leafnodes.begin();
+}
 
-	char file_object[100];
-	sprintf( file_object, "%s", FILE_OBJECT );
-	FILE *fin = fopen( file_object, "r" );
-	int oid, id;
-	while( fscanf( fin, "%d %d", &oid, &id ) == 2 ){
-		o.push_back(oid);
+// an object on an edge, or on a vertex(snid == enid, offset 0) of an object set that has edge objects
+typedef struct{
+	int oid; // id in the object file
+	int snid, enid; // ends of the edge, node ids
+	int offset; // distance from snid along the edge, inflated as the edge weights
+	int weight; // of the edge
+}EdgeObject;
+
+// an object set(category) with its OCCURENCE LIST, every set shares the one loaded index
+// a vertex is listed in its leaf's leafinvlist while it holds an object of the set, a tree node in
+// its father's nonleafinvlist while its subtree does, so a query on the set never expands a tree
+// node without its objects. sizes are per object and per tree node, not per vertex
+// objects on edges are listed at both ends, a search reaching an end goes on to the objects there
+// (see pop_vertex()), results of such a set are indexes into edgeobjects instead of vertices
+struct ObjectSet{
+	string name;
+	vector< vector<int> > leafinvlist; // per leaf, positions in leafnodes of vertices holding objects
+	vector< vector<int> > leafcount; // objects on each of them
+	vector< vector<int> > leafslot; // per leaf, index of each position of leafnodes in leafinvlist, -1 if not listed
+	vector< vector<int> > nonleafinvlist; // per tree node, children with objects under them
+	vector<int> tree_objects; // objects under each tree node
+	vector<int> tree_slot; // index of each tree node in its father's nonleafinvlist, -1 if not listed
+	unordered_map<long long,int> kth; // reverse_knn(), K * |V| + vertex -> distance to its K+1-th nearest object
+	vector<EdgeObject> edgeobjects; // empty for a set of vertex objects, oid = -1 once removed
+	unordered_map< int, vector<int> > endpoints; // vertex -> edgeobjects with an end on it
+
+	void init( const char *_name ){
+		name = _name;
+		leafinvlist.assign( GTree.size(), vector<int>() );
+		leafcount.assign( GTree.size(), vector<int>() );
+		leafslot.assign( GTree.size(), vector<int>() );
+		nonleafinvlist.assign( GTree.size(), vector<int>() );
+		tree_objects.assign( GTree.size(), 0 );
+		tree_slot.assign( GTree.size(), -1 );
+		kth.clear();
+		edgeobjects.clear();
+		endpoints.clear();
 	}
-	fclose(fin);
 
-	// set OCCURENCE LIST
-	for ( int i = 0; i < o.size(); i++ ){
-		int current = Nodes[o[i]].gtreepath.back();
-		// add leaf inv list
-		int pos = lower_bound( GTree[current].leafnodes.begin(), GTree[current].leafnodes.end(), o[i] ) - GTree[current].leafnodes.begin();
-		GTree[current].leafinvlist.push_back(pos);		
-		// recursive
-		int child;
-		while( current != -1 ){
-			child = current;
-			current = GTree[current].father;
-			if ( current == -1 ) break;
-			if ( find(GTree[current].nonleafinvlist.begin(), GTree[current].nonleafinvlist.end(), child ) == GTree[current].nonleafinvlist.end() ){
-				GTree[current].nonleafinvlist.push_back(child);
+	// add an object on vertex v(node id of Nodes), O(depth)
+	void add( int v ){
+		int tn = Nodes.gtreepath(v).back(), pos = leaf_pos( tn, v );
+		vector<int> &list = leafinvlist[tn], &slots = leafslot[tn];
+		if ( slots.empty() ) slots.assign( GTree[tn].leafnodes.size(), -1 );
+		if ( slots[pos] == -1 ){
+			slots[pos] = list.size();
+			list.push_back( pos );
+			leafcount[tn].push_back( 0 );
+		}
+		leafcount[tn][slots[pos]]++;
+		if ( ! kth.empty() ) kth.clear();
+		for ( ; tn != -1; tn = GTree[tn].father ){
+			if ( tree_objects[tn]++ == 0 && GTree[tn].father != -1 ){
+				vector<int> &up = nonleafinvlist[GTree[tn].father];
+				tree_slot[tn] = up.size();
+				up.push_back( tn );
 			}
 		}
 	}
 
-	// up_pos & current_pos(used for quickly locating parent & child nodes)
-	unordered_map<int,int> pos_map;
-	for ( int i = 1; i < GTree.size(); i++ ){
-		GTree[i].current_pos.clear();
-		GTree[i].up_pos.clear();
+	// remove an object from vertex v, emptied entries are swapped with the last one
+	// output: false if v holds no object of the set
+	bool remove( int v ){
+		int tn = Nodes.gtreepath(v).back(), pos = leaf_pos( tn, v ), last;
+		vector<int> &list = leafinvlist[tn], &count = leafcount[tn], &slots = leafslot[tn];
+		if ( slots.empty() || slots[pos] == -1 ) return false;
+		int slot = slots[pos];
+		if ( ! kth.empty() ) kth.clear();
+		if ( --count[slot] == 0 ){
+			list[slot] = list.back();
+			slots[list[slot]] = slot;
+			slots[pos] = -1;
+			list.pop_back();
+			count[slot] = count.back();
+			count.pop_back();
+		}
+		for ( ; tn != -1; tn = GTree[tn].father ){
+			if ( --tree_objects[tn] == 0 && GTree[tn].father != -1 ){
+				vector<int> &up = nonleafinvlist[GTree[tn].father];
+				last = up.back();
+				up[tree_slot[tn]] = last;
+				tree_slot[last] = tree_slot[tn];
+				tree_slot[tn] = -1;
+				up.pop_back();
+			}
+		}
+		return true;
+	}
 
-		// current_pos
-		pos_map.clear();
-		for ( int j = 0; j < GTree[i].union_borders.size(); j++ ){
-			pos_map[GTree[i].union_borders[j]] = j;
+	// add an object on an edge, output: its index in edgeobjects
+	int add_edge( EdgeObject &o ){
+		int i = edgeobjects.size();
+		edgeobjects.push_back( o );
+		add( o.snid );
+		endpoints[o.snid].push_back( i );
+		if ( o.enid != o.snid ){
+			add( o.enid );
+			endpoints[o.enid].push_back( i );
 		}
-		for ( int j = 0; j < GTree[i].borders.size(); j++ ){
-			GTree[i].current_pos.push_back(pos_map[GTree[i].borders[j]]);
+		return i;
+	}
+
+	// remove the object of index i in edgeobjects, its index is not reused
+	// output: false if it is removed already
+	bool remove_edge( int i ){
+		EdgeObject &o = edgeobjects[i];
+		if ( o.oid == -1 ) return false;
+		for ( int e = 0; e < 2; e++ ){
+			int v = e == 0 ? o.snid : o.enid;
+			if ( e == 1 && v == o.snid ) break;
+			remove( v );
+			vector<int> &list = endpoints[v];
+			list.erase( find( list.begin(), list.end(), i ) );
 		}
-		// up_pos
-		pos_map.clear();
-		for ( int j = 0; j < GTree[GTree[i].father].union_borders.size(); j++ ){
-			pos_map[GTree[GTree[i].father].union_borders[j]] = j;
+		o.oid = -1;
+		return true;
+	}
+};
+vector<ObjectSet> objectsets; // objectsets[0] is FILE_OBJECT, named "default"
+
+// index of the object set named name, -1 if there is none
+int object_set( const char *name ){
+	for ( int i = 0; i < objectsets.size(); i++ ){
+		if ( objectsets[i].name == name ) return i;
+	}
+	return -1;
+}
+
+// weight of the lightest edge u-v, -1 if there is none
+int edge_weight( int u, int v ){
+	const int *adj = Nodes.adj( u ), *wgt = Nodes.wgt( u );
+	int w = -1;
+	for ( int p = 0; p < Nodes.degree( u ); p++ ){
+		if ( adj[p] == v && ( w == -1 || wgt[p] < w ) ) w = wgt[p];
+	}
+	return w;
+}
+
+// load an object file as object set name, "vertex id" per line, or "oid snid enid offset" for an
+// object on edge snid-enid, offset from snid as the weights of FILE_EDGE
+// a file with any edge object gives a set of edge objects, its vertex objects are taken as on
+// their vertex with oid = vertex id
+// output: index of the set, -1 if the file cannot be read
+int load_objects( const char *name, const char *file ){
+	FILE *fin = fopen( file, "r" );
+	if ( fin == NULL ){
+		printf("CANNOT OPEN OBJECT FILE %s\n", file);
+		return -1;
+	}
+	objectsets.push_back( ObjectSet() );
+	ObjectSet &set = objectsets.back();
+	set.init( name );
+	char line[256];
+	int oid, snid, enid, n;
+	double offset;
+	vector<EdgeObject> objects;
+	bool onedges = false;
+	while( fgets( line, sizeof(line), fin ) != NULL ){
+		n = sscanf( line, "%d %d %d %lf", &oid, &snid, &enid, &offset );
+		if ( n == 4 ){
+			if ( snid < 0 || snid >= Nodes.size() || enid < 0 || enid >= Nodes.size() ) continue;
+			EdgeObject o = { oid, to_new(snid), to_new(enid), (int)( offset * WEIGHT_INFLATE_FACTOR ), 0 };
+			o.weight = o.snid == o.enid ? 0 : edge_weight( o.snid, o.enid );
+			if ( o.weight == -1 || o.offset < 0 || o.offset > o.weight ){
+				printf("OBJECT %d IS NOT ON AN EDGE\n", oid);
+				continue;
+			}
+			objects.push_back( o );
+			onedges = true;
 		}
-		for ( int j = 0; j < GTree[i].borders.size(); j++ ){
-			GTree[i].up_pos.push_back(pos_map[GTree[i].borders[j]]);
+		else if ( n >= 2 ){
+			EdgeObject o = { oid, to_new(oid), to_new(oid), 0, 0 };
+			objects.push_back( o );
 		}
 	}
+	fclose(fin);
+	for ( int i = 0; i < objects.size(); i++ ){
+		if ( onedges ) set.add_edge( objects[i] );
+		else set.add( objects[i].snid );
+	}
+	return objectsets.size() - 1;
+}
+
+// move objects of object set set, vertex objects only(objects on edges move by add_edge()/remove_edge()
+// of the set, which keep its edgeobjects and endpoints along)
+// output: false if the set is on edges, or v holds no object of the set to remove
+bool add_object( int v, int set = 0 ){
+	if ( ! objectsets[set].edgeobjects.empty() ) return false;
+	objectsets[set].add( v );
+	return true;
+}
+
+bool remove_object( int v, int set = 0 ){
+	if ( ! objectsets[set].edgeobjects.empty() ) return false;
+	return objectsets[set].remove( v );
+}
+
+// id of a query result as the input files have it, the vertex id, or the object id of a set on edges
+int result_id( int id, int set ){
+	return objectsets[set].edgeobjects.empty() ? to_old( id ) : objectsets[set].edgeobjects[id].oid;
+}
+
+// before query, we have to set OCCURENCE LIST etc.
+// this is done only ONCE for a given set of objects, later moves go through add_object()/remove_object()
+// FILE_OBJECT becomes object set 0, more sets(categories) are added by load_objects()
+void pre_query(){
+	objectsets.clear();
+	load_objects( "default", FILE_OBJECT );
 }
 
 // init search node
+// an object of a set on edges is an entry with isvertex and lca_pos = -1, id its index in edgeobjects
 typedef struct{
 	int id;
 	bool isvertex;
@@ -384,211 +507,339 @@ typedef struct{
 	int dis;
 }Status_query;
 
-struct Status_query_comp{
-	bool operator()( const Status_query& l, const Status_query& r ){
-		return l.dis > r.dis;
-	}
-};
-
 typedef struct{
 	int id;
 	int dis;
 }ResultSet;
 
-// ----- CORE PART -----
-// knn search
-// input: locid = query location, node id
-//        K = top-K
-// output: a vector of ResultSet, each is a tuple (node id, shortest path), ranked by shortest path distance from query location
-vector<ResultSet> knn_query( int locid, int K ){
-	// init priority queue & result set
-	vector<Status_query> pq;
-	pq.clear();
+// a change of the knn set along a route, see continuous_knn()
+typedef struct{
+	int pos; // position in the route
+	vector<ResultSet> knn; // result at the vertex there
+}RouteSplit;
+
+// first slot of each tree node in QueryContext::itmarena, tree nodes take a slot per border
+vector<int> itm_offset;
+
+void itm_layout(){
+	itm_offset.assign( 1, 0 );
+	for ( int i = 0; i < GTree.size(); i++ ){
+		itm_offset.push_back( itm_offset.back() + GTree[i].borders.size() );
+	}
+}
+
+// first matrix column of each tree node's up_pos/current_pos, if they are a consecutive run, -1 otherwise
+// (borders of a renumbered index mostly are), min-plus rows are read without a gather then
+vector<int> up_run, current_run;
+
+int pos_run( const IntArray &pos ){
+	for ( int k = 1; k < pos.size(); k++ ){
+		if ( pos[k] != pos[0] + k ) return -1;
+	}
+	return pos.size() > 0 ? pos[0] : -1;
+}
+
+void pos_layout(){
+	up_run.resize( GTree.size() );
+	current_run.resize( GTree.size() );
+	for ( int i = 0; i < GTree.size(); i++ ){
+		up_run[i] = pos_run( GTree[i].up_pos );
+		current_run[i] = pos_run( GTree[i].current_pos );
+	}
+}
+
+// min over k < n of a[k] + mind(row, pos[k]), run = pos[0] if pos is a consecutive run, -1 otherwise
+// output: -1 if n == 0
+inline int mind_minplus( const DistMatrix &mind, int row, const int *a, const int *pos, int run, int n ){
+	if ( n == 0 ) return -1;
+	if ( mind.rows == NULL ){
+		const int *r = mind.data + (long long)row * mind.cols;
+		return run >= 0 ? minplus( a, r + run, NULL, n ) : minplus( a, r, pos, n );
+	}
+	int min = a[0] + mind.at( row, pos[0] ), dis;
+	for ( int k = 1; k < n; k++ ){
+		dis = a[k] + mind.at( row, pos[k] );
+		if ( dis < min ) min = dis;
+	}
+	return min;
+}
+
+// per thread query state with buffers reused from query to query,
+// the index(Nodes, GTree) is only read once pre_query() is done
+struct QueryContext{
+	Dijkstra dijkstra; // in-leaf search
+	QuadHeap<Status_query> pq; // best-first queue, its counters run over all searches of the context
+	vector<int> itmarena; // intermediate answer, distance to each border of each tree node, see itm()
+	vector<int> cands, result;
 	vector<ResultSet> rstset;
-	rstset.clear();
+	// knn_batch(), see batch_upstream()
+	vector< vector<int> > up, upbase, upstride;
+	vector<int> locs, maxk;
+	// aggregate_knn()
+	vector<int> aggarena, score;
+	// knn_path(), tree nodes whose aggitm(0, ...) is set in the current path epoch
+	vector<unsigned> pathstamp;
+	unsigned pathepoch;
+	// pop_vertex(), edge objects found in the current search epoch
+	vector<unsigned> objstamp;
+	unsigned objepoch;
 
-	// init upstream
-	unordered_map<int, vector<int> > itm; // intermediate answer, tree node -> array
-	itm.clear();
-	int tn, cid, posa, posb, min, dis;
-	for ( int i = Nodes[locid].gtreepath.size() - 1; i > 0; i-- ){
-		tn = Nodes[locid].gtreepath[i];
-		itm[tn].clear();
+	// after the index is loaded
+	void init(){
+		dijkstra.init( Nodes.size() );
+		itmarena.assign( itm_offset.back(), 0 );
+		pathstamp.assign( GTree.size(), 0 );
+		pathepoch = 0;
+		objepoch = 0;
+	}
+
+	// a new search on objs
+	void begin_search( const ObjectSet &objs ){
+		if ( objs.edgeobjects.empty() ) return;
+		if ( objstamp.size() < objs.edgeobjects.size() ) objstamp.resize( objs.edgeobjects.size(), 0 );
+		if ( ++objepoch == 0 ){
+			objstamp.assign( objstamp.size(), 0 );
+			objepoch = 1;
+		}
+	}
+
+	// intermediate answer of tree node tn, a slot per border
+	// every slot a query reads is written before in the same query, so it is never cleared
+	int* itm( int tn ){ return &itmarena[itm_offset[tn]]; }
+
+	// intermediate answer of tree node tn for the i-th location of aggregate_knn()
+	int* aggitm( int i, int tn ){ return &aggarena[(long long)i * itm_offset.back() + itm_offset[tn]]; }
+};
+QueryContext mainctx; // context of the main thread
+
+// ----- CORE PART -----
+// upstream: distance from locid to the borders of each tree node on its gtreepath(root excluded)
+// output: ctx.itm(tn), distance to each border of tree node tn
+void knn_upstream( int locid, QueryContext &ctx ){
+	IntArray gtreepath = Nodes.gtreepath(locid);
+	int tn, cid, posa;
+	for ( int i = gtreepath.size() - 1; i > 0; i-- ){
+		tn = gtreepath[i];
 
 		if ( GTree[tn].isleaf ){
-			posa = lower_bound( GTree[tn].leafnodes.begin(), GTree[tn].leafnodes.end(), locid ) - GTree[tn].leafnodes.begin();
+			posa = leaf_pos( tn, locid );
 
 			for ( int j = 0; j < GTree[tn].borders.size(); j++ ){
-				itm[tn].push_back( GTree[tn].mind[ j * GTree[tn].leafnodes.size() + posa ] );
+				ctx.itm(tn)[j] = GTree[tn].mind.at( j, posa );
 			}
 		}
 		else{
-			cid = Nodes[locid].gtreepath[i+1];
+			cid = gtreepath[i+1];
+			const int *citm = ctx.itm(cid);
 			for ( int j = 0; j < GTree[tn].borders.size(); j++ ){
-				min = -1;
 				posa = GTree[tn].current_pos[j];
-				for ( int k = 0; k < GTree[cid].borders.size(); k++ ){
-					posb = GTree[cid].up_pos[k];
-					dis = itm[cid][k] + GTree[tn].mind[ posa * GTree[tn].union_borders.size() + posb ];
-					// get min
-					if ( min == -1 ){
-						min = dis;
-					}
-					else{
-						if ( dis < min ){
-							min = dis;
-						}
-					}
-				}
-				// update
-				itm[tn].push_back( min );
+				ctx.itm(tn)[j] = mind_minplus( GTree[tn].mind, posa, citm, GTree[cid].up_pos.begin(), up_run[cid], GTree[cid].borders.size() );
 			}
 		}
 
 	}
+}
 
-	// do search
-	Status_query rootstatus = { 0, false, 0, 0 };
-	pq.push_back( rootstatus );
-	make_heap( pq.begin(), pq.end(), Status_query_comp() );
+// distances from locid to cands, the vertices at positions pos of its own leaf tn: a row of the
+// in-leaf distances if they are loaded, a dijkstra otherwise
+void leaf_candidate( int tn, int locid, const vector<int> &pos, vector<int> &cands, QueryContext &ctx, vector<int> &output ){
+	if ( ! leafdist.loaded() ){
+		ctx.dijkstra.candidate( locid, cands, Nodes, output );
+		return;
+	}
+	const int *row = leafdist.row( tn, leaf_pos( tn, locid ), GTree[tn].leafnodes.size() );
+	output.resize( pos.size() );
+	for ( int i = 0; i < pos.size(); i++ ){
+		output[i] = row[pos[i]];
+	}
+}
 
-	vector<int> cands, result;
-	int child, son, allmin, vertex;
+// a vertex entry popped by a search on objs
+// output: true if it is a result, a vertex holding objects of a set of vertex objects, or an edge object
+// popped for the first time(through its nearer end). a vertex of a set on edges pushes an entry for each
+// object with an end on it instead, at the distance through that end
+bool pop_vertex( Status_query &top, const ObjectSet &objs, QueryContext &ctx ){
+	if ( objs.edgeobjects.empty() ) return true;
+	if ( top.lca_pos == -1 ){
+		if ( ctx.objstamp[top.id] == ctx.objepoch ) return false;
+		ctx.objstamp[top.id] = ctx.objepoch;
+		return true;
+	}
+	unordered_map< int, vector<int> >::const_iterator it = objs.endpoints.find( top.id );
+	if ( it == objs.endpoints.end() ) return false;
+	for ( int i = 0; i < it->second.size(); i++ ){
+		const EdgeObject &o = objs.edgeobjects[it->second[i]];
+		if ( ctx.objstamp[it->second[i]] == ctx.objepoch ) continue;
+		Status_query status = { it->second[i], true, -1, top.dis + ( top.id == o.snid ? o.offset : o.weight - o.offset ) };
+		ctx.pq.push( status );
+	}
+	return false;
+}
 
-	while( pq.size() > 0 && rstset.size() < K ){
-		Status_query top = pq[0];
-		pop_heap( pq.begin(), pq.end(), Status_query_comp() );
-		pq.pop_back();
+// best-first knn search as an iterator, each next() yields the next nearest object of locid
+// the search state(priority queue, itm) stays in the context, which runs no other query while the
+// iterator is used(a context per live iterator), so asking for a few more objects costs only those
+struct KnnIterator{
+	QueryContext *qctx;
+	const ObjectSet *qobjs;
+	int locid, radius;
+	IntArray gtreepath;
 
-		if ( top.isvertex ){
-			ResultSet rs = { top.id, top.dis };
-			rstset.push_back(rs);
-		}
-		else{
-			if ( GTree[top.id].isleaf ){
-				// inner of leaf node, do dijkstra
-				if ( top.id == Nodes[locid].gtreepath[top.lca_pos] ){
+	// start from locid, given its upstream distances in ctx.itm()
+	// distances of the other tree nodes visited are written there too
+	// only objects of objs are searched, tree nodes without them are never expanded
+	// radius >= 0 stops at the first entry farther than radius, tree nodes whose lower bound
+	// exceeds it are never expanded
+	void start( int _locid, QueryContext &ctx, const ObjectSet &objs, int _radius = -1 ){
+		qctx = &ctx;
+		qobjs = &objs;
+		locid = _locid;
+		radius = _radius;
+		gtreepath = Nodes.gtreepath(locid);
+		ctx.pq.clear();
+		ctx.begin_search( objs );
+		Status_query rootstatus = { 0, false, 0, 0 };
+		ctx.pq.push( rootstatus );
+	}
+
+	// output: rs = the next nearest object, false if there is none(within radius)
+	bool next( ResultSet &rs ){
+		QueryContext &ctx = *qctx;
+		const ObjectSet &objs = *qobjs;
+		QuadHeap<Status_query> &pq = ctx.pq;
+		vector<int> &cands = ctx.cands, &result = ctx.result;
+		int posa, min, dis, child, son, allmin, vertex, first;
+
+		while( ! pq.empty() ){
+			Status_query top = pq.top();
+			if ( radius >= 0 && top.dis > radius ) return false;
+			pq.pop();
+
+			if ( top.isvertex ){
+				if ( pop_vertex( top, objs, ctx ) ){
+					rs.id = top.id;
+					rs.dis = top.dis;
+					return true;
+				}
+			}
+			else{
+				if ( GTree[top.id].isleaf ){
+					// inner of leaf node, do dijkstra(or read the in-leaf distances)
+					if ( top.id == gtreepath[top.lca_pos] ){
 					
-					cands.clear();
-					for ( int i = 0; i < GTree[top.id].leafinvlist.size(); i++ ){
-						cands.push_back( GTree[top.id].leafnodes[GTree[top.id].leafinvlist[i]] );
-					}
-					result = dijkstra_candidate( locid, cands, Nodes );
-					for ( int i = 0; i < cands.size(); i++ ){
-						Status_query status = { cands[i], true, top.lca_pos, result[i] };
-						pq.push_back(status);
-						push_heap( pq.begin(), pq.end(), Status_query_comp() );
-					}
+						cands.clear();
+						const vector<int> &leafinvlist = objs.leafinvlist[top.id];
+						for ( int i = 0; i < leafinvlist.size(); i++ ){
+							cands.push_back( GTree[top.id].leafnodes[leafinvlist[i]] );
+						}
+						leaf_candidate( top.id, locid, leafinvlist, cands, ctx, result );
+						first = pq.size();
+						for ( int i = 0; i < cands.size(); i++ ){
+							Status_query status = { cands[i], true, top.lca_pos, result[i] };
+							pq.append( status );
+						}
+						pq.heapify_from( first );
 					
-				}
+					}
 	
-				// else do 
-				else{
-					for ( int i = 0; i < GTree[top.id].leafinvlist.size(); i++ ){
-						posa = GTree[top.id].leafinvlist[i];
-						vertex = GTree[top.id].leafnodes[posa];
-						allmin = -1;
+					// else do 
+					else{
+						const int *titm = ctx.itm(top.id);
+						const vector<int> &leafinvlist = objs.leafinvlist[top.id];
+						first = pq.size();
+						for ( int i = 0; i < leafinvlist.size(); i++ ){
+							posa = leafinvlist[i];
+							vertex = GTree[top.id].leafnodes[posa];
+							allmin = -1;
 
-						for ( int k = 0; k < GTree[top.id].borders.size(); k++ ){
-							dis = itm[top.id][k] + GTree[top.id].mind[ k * GTree[top.id].leafnodes.size() + posa ];
-							if ( allmin == -1 ){
-								allmin = dis;
-							}
-							else{
-								if ( dis < allmin ){
+							for ( int k = 0; k < GTree[top.id].borders.size(); k++ ){
+								dis = titm[k] + GTree[top.id].mind.at( k, posa );
+								if ( allmin == -1 ){
 									allmin = dis;
 								}
-							}
+								else{
+									if ( dis < allmin ){
+										allmin = dis;
+									}
+								}
 
-						}
+							}
 						
-						Status_query status = { vertex, true, top.lca_pos, allmin };
-						pq.push_back(status);
-						push_heap( pq.begin(), pq.end(), Status_query_comp() );
+							Status_query status = { vertex, true, top.lca_pos, allmin };
+							pq.append( status );
 
+						}
+						pq.heapify_from( first );
 					}
 				}
-			}
-			else{
-				for ( int i = 0; i < GTree[top.id].nonleafinvlist.size(); i++ ){
-					child = GTree[top.id].nonleafinvlist[i];
-					son = Nodes[locid].gtreepath[ top.lca_pos + 1 ];
-					// on gtreepath
-					if ( child == son ){
-						Status_query status = { child, false, top.lca_pos + 1, 0 };
-						pq.push_back(status);
-						push_heap( pq.begin(), pq.end(), Status_query_comp() );
-					}
-					// brothers
-					else if ( GTree[child].father == GTree[son].father ){
-						itm[child].clear();
-						allmin = -1;
-
-						for ( int j = 0; j < GTree[child].borders.size(); j++ ){
-							min = -1;
-							posa = GTree[child].up_pos[j];
-							for( int k = 0; k < GTree[son].borders.size(); k++ ){
-								posb = GTree[son].up_pos[k];
-								dis = itm[son][k] + GTree[top.id].mind[ posa * GTree[top.id].union_borders.size() + posb ];
-								if ( min == -1 ){
-									min = dis;
+				else{
+					const vector<int> &nonleafinvlist = objs.nonleafinvlist[top.id];
+					for ( int i = 0; i < nonleafinvlist.size(); i++ ){
+						child = nonleafinvlist[i];
+						son = gtreepath[ top.lca_pos + 1 ];
+						// on gtreepath
+						if ( child == son ){
+							Status_query status = { child, false, top.lca_pos + 1, 0 };
+							pq.push( status );
+						}
+						// brothers
+						else if ( GTree[child].father == GTree[son].father ){
+							allmin = -1;
+							const int *sitm = ctx.itm(son);
+
+							for ( int j = 0; j < GTree[child].borders.size(); j++ ){
+								posa = GTree[child].up_pos[j];
+								min = mind_minplus( GTree[top.id].mind, posa, sitm, GTree[son].up_pos.begin(), up_run[son], GTree[son].borders.size() );
+								ctx.itm(child)[j] = min;
+								// update all min
+								if ( allmin == -1 ){
+									allmin = min;
 								}
-								else{
-									if ( dis < min ){
-										min = dis;
-									}
+								else if ( min < allmin ){
+									allmin = min;
 								}
 							}
-							itm[child].push_back(min);	
-							// update all min
-							if ( allmin == -1 ){
-								allmin = min;
-							}
-							else if ( min < allmin ){
-								allmin = min;
-							}
+							Status_query status = { child, false, top.lca_pos, allmin };
+							pq.push( status );
 						}
-						Status_query status = { child, false, top.lca_pos, allmin };
-						pq.push_back(status);
-						push_heap( pq.begin(), pq.end(), Status_query_comp() );
-					}
-					// downstream
-					else{
-						itm[child].clear();
-						allmin = -1;
+						// downstream
+						else{
+							allmin = -1;
+							const int *titm = ctx.itm(top.id);
 						
-						for ( int j = 0; j < GTree[child].borders.size(); j++ ){
-							min = -1;
-							posa = GTree[child].up_pos[j];
-							for ( int k = 0; k < GTree[top.id].borders.size(); k++ ){
-								posb = GTree[top.id].current_pos[k];
-								dis = itm[top.id][k] + GTree[top.id].mind[ posa * GTree[top.id].union_borders.size() + posb ];
-								if ( min == -1 ){
-									min = dis;
+							for ( int j = 0; j < GTree[child].borders.size(); j++ ){
+								posa = GTree[child].up_pos[j];
+								min = mind_minplus( GTree[top.id].mind, posa, titm, GTree[top.id].current_pos.begin(), current_run[top.id], GTree[top.id].borders.size() );
+								ctx.itm(child)[j] = min;
+								// update all min
+								if ( allmin == -1 ){
+									allmin = min;
 								}
-								else{
-									if ( dis < min ){
-										min = dis;
-									}
+								else if ( min < allmin ){
+									allmin = min;
 								}
 							}
-							itm[child].push_back(min);
-							// update all min
-							if ( allmin == -1 ){
-								allmin = min;
-							}
-							else if ( min < allmin ){
-								allmin = min;
-							}
+							Status_query status = { child, false, top.lca_pos, allmin };
+							pq.push( status );
 						}
-						Status_query status = { child, false, top.lca_pos, allmin };
-                        pq.push_back(status);
-                        push_heap( pq.begin(), pq.end(), Status_query_comp() );
 					}
 				}
-			}
 			
+			}
 		}
+		return false;
+	}
+};
+
+// search for the K nearest objects of locid, given its upstream distances in ctx.itm(), see KnnIterator
+vector<ResultSet>& knn_search( int locid, int K, QueryContext &ctx, const ObjectSet &objs, int radius = -1 ){
+	vector<ResultSet> &rstset = ctx.rstset;
+	rstset.clear();
+	KnnIterator it;
+	it.start( locid, ctx, objs, radius );
+	ResultSet rs;
+	while( rstset.size() < K && it.next( rs ) ){
+		rstset.push_back( rs );
 	}
 
 	/* ----- return id list -----
@@ -603,37 +854,1505 @@ vector<ResultSet> knn_query( int locid, int K ){
 	return rstset;
 }
 
-int main(){
-	// init
-	TIME_TICK_START
-	init();
-	TIME_TICK_END
-	TIME_TICK_PRINT("INIT")
+// knn search
+// input: locid = query location, node id
+//        K = top-K
+// output: a vector of ResultSet, each is a tuple (node id, shortest path), ranked by shortest path distance from query location
+// node ids are those of Nodes, see to_new()/to_old()
+//        set = object set to search, see load_objects()
+// the result is kept in ctx until its next query
+vector<ResultSet>& knn_query( int locid, int K, QueryContext &ctx = mainctx, int set = 0 ){
+	// init upstream
+	knn_upstream( locid, ctx );
 
-	// load gtree index
-	gtree_load();
+	// do search
+	return knn_search( locid, K, ctx, objectsets[set] );
+}
 
-	// load distance matrix
-	hierarchy_shortest_path_load();
+// range search
+// input: locid = query location, node id
+//        R = network distance bound, in the inflated weights of Nodes
+// output: every object within distance R of locid, ranked as knn_query() does
+// the result is kept in ctx until its next query
+vector<ResultSet>& range_query( int locid, int R, QueryContext &ctx = mainctx, int set = 0 ){
+	knn_upstream( locid, ctx );
+	return knn_search( locid, INT_MAX, ctx, objectsets[set], R );
+}
 
-	// pre query init
-	pre_query();
+// incremental knn search
+// input: locid = query location, node id
+// output: an iterator whose next() yields the objects of set by distance from locid, as far as asked
+// for, the search state is kept in ctx until its next query
+KnnIterator knn_iterator( int locid, QueryContext &ctx = mainctx, int set = 0 ){
+	knn_upstream( locid, ctx );
+	KnnIterator it;
+	it.start( locid, ctx, objectsets[set] );
+	return it;
+}
 
-	// knn search
-	// example
-	printf("KNN Search Started...\n");
-	int locid, K;
-	vector<ResultSet> result;
-	while(scanf("%d %d", &locid, &K) == 2){
-		if (locid >= Nodes.size() || locid < 0 || K < 0 || K > Nodes.size()) continue;
+// upstream of locid as the i-th location of aggregate_knn(), into ctx.aggitm(i, ...)
+void agg_upstream( QueryContext &ctx, int i, int locid ){
+	knn_upstream( locid, ctx );
+	IntArray gtreepath = Nodes.gtreepath(locid);
+	for ( int p = 1; p < gtreepath.size(); p++ ){
+		int tn = gtreepath[p];
+		copy( ctx.itm(tn), ctx.itm(tn) + GTree[tn].borders.size(), ctx.aggitm( i, tn ) );
+	}
+}
 
-		TIME_TICK_START
-		result = knn_query(locid, K);
-		TIME_TICK_END
-		for ( int i = 0; i < result.size(); i++ ){
-			printf("ID=%d DIS=%d\n", result[i].id, result[i].dis );
+// border distances of tree node child, whose father tn is at depth d, from the i-th location of
+// aggregate_knn(), gtreepath is that of the location, which is not inside child
+// output: ctx.aggitm(i, child), and the smallest of them
+int agg_child( QueryContext &ctx, int i, IntArray &gtreepath, int d, int tn, int child ){
+	int *out = ctx.aggitm( i, child ), bound = -1;
+	for ( int j = 0; j < GTree[child].borders.size(); j++ ){
+		int posa = GTree[child].up_pos[j];
+		// brothers
+		if ( gtreepath.size() > d + 1 && gtreepath[d] == tn ){
+			int son = gtreepath[d+1];
+			out[j] = mind_minplus( GTree[tn].mind, posa, ctx.aggitm( i, son ), GTree[son].up_pos.begin(), up_run[son], GTree[son].borders.size() );
+		}
+		// downstream
+		else{
+			out[j] = mind_minplus( GTree[tn].mind, posa, ctx.aggitm( i, tn ), GTree[tn].current_pos.begin(), current_run[tn], GTree[tn].borders.size() );
+		}
+		if ( bound == -1 || out[j] < bound ) bound = out[j];
+	}
+	return bound;
+}
+
+// aggregate knn search
+// input: locids = query locations, node ids
+//        K = top-K
+//        aggmax = score of an object is its largest distance from locids, the sum of them otherwise
+//        offsets = if given, score of an object is the smallest offsets[i] + distance from locids[i]
+//        instead, the distance from a point reached from each location at that extra distance(e.g. a
+//        point on an edge, see knn_edge_query()). sets of edge objects are searched only this way
+// output: a vector of ResultSet, (node id, score) of the K objects with the smallest score, ranked by it
+// each location gets its own upstream pass, then one best-first traversal ranks tree nodes by the
+// aggregate of their per-location lower bounds(0 for a location inside)
+// the result is kept in ctx until its next query
+vector<ResultSet>& aggregate_knn( vector<int> &locids, int K, bool aggmax, QueryContext &ctx = mainctx, int set = 0, const vector<int> *offsets = NULL ){
+	const ObjectSet &objs = objectsets[set];
+	int m = locids.size();
+	ctx.begin_search( objs );
+	ctx.aggarena.resize( (long long)m * itm_offset.back() );
+
+	// upstream of each location
+	for ( int i = 0; i < m; i++ ){
+		agg_upstream( ctx, i, locids[i] );
+	}
+
+	QuadHeap<Status_query> &pq = ctx.pq;
+	pq.clear();
+	vector<ResultSet> &rstset = ctx.rstset;
+	rstset.clear();
+	vector<int> &cands = ctx.cands, &result = ctx.result, &score = ctx.score;
+
+	// lca_pos of a tree node entry is its depth
+	Status_query rootstatus = { 0, false, 0, 0 };
+	pq.push( rootstatus );
+
+	while( ! pq.empty() && rstset.size() < K ){
+		Status_query top = pq.top();
+		pq.pop();
+		int d = top.lca_pos, dis;
+
+		if ( top.isvertex ){
+			if ( pop_vertex( top, objs, ctx ) ){
+				ResultSet rs = { top.id, top.dis };
+				rstset.push_back(rs);
+			}
+		}
+		else if ( GTree[top.id].isleaf ){
+			// exact distance from each location to each object of the leaf
+			const vector<int> &leafinvlist = objs.leafinvlist[top.id];
+			cands.clear();
+			for ( int j = 0; j < leafinvlist.size(); j++ ){
+				cands.push_back( GTree[top.id].leafnodes[leafinvlist[j]] );
+			}
+			score.assign( cands.size(), 0 );
+			for ( int i = 0; i < m; i++ ){
+				if ( Nodes.gtreepath(locids[i]).back() == top.id ){
+					leaf_candidate( top.id, locids[i], leafinvlist, cands, ctx, result );
+				}
+				else{
+					const int *aitm = ctx.aggitm( i, top.id );
+					result.resize( cands.size() );
+					for ( int j = 0; j < cands.size(); j++ ){
+						result[j] = -1;
+						for ( int k = 0; k < GTree[top.id].borders.size(); k++ ){
+							dis = aitm[k] + GTree[top.id].mind.at( k, leafinvlist[j] );
+							if ( result[j] == -1 || dis < result[j] ) result[j] = dis;
+						}
+					}
+				}
+				for ( int j = 0; j < cands.size(); j++ ){
+					if ( offsets != NULL ) score[j] = i == 0 ? (*offsets)[i] + result[j] : min( score[j], (*offsets)[i] + result[j] );
+					else score[j] = aggmax ? max( score[j], result[j] ) : score[j] + result[j];
+				}
+			}
+			int first = pq.size();
+			for ( int j = 0; j < cands.size(); j++ ){
+				Status_query status = { cands[j], true, d, score[j] };
+				pq.append( status );
+			}
+			pq.heapify_from( first );
+		}
+		else{
+			const vector<int> &nonleafinvlist = objs.nonleafinvlist[top.id];
+			for ( int c = 0; c < nonleafinvlist.size(); c++ ){
+				int child = nonleafinvlist[c], total = 0, bound;
+				for ( int i = 0; i < m; i++ ){
+					IntArray gtreepath = Nodes.gtreepath(locids[i]);
+					// location inside child, its upstream is there already
+					if ( gtreepath.size() > d + 1 && gtreepath[d+1] == child ){
+						bound = 0;
+					}
+					else{
+						bound = agg_child( ctx, i, gtreepath, d, top.id, child );
+					}
+					if ( offsets != NULL ) total = i == 0 ? (*offsets)[i] + bound : min( total, (*offsets)[i] + bound );
+					else total = aggmax ? max( total, bound ) : total + bound;
+				}
+				Status_query status = { child, false, d + 1, total };
+				pq.push( status );
+			}
+		}
+	}
+	return rstset;
+}
+
+// knn search from a point on an edge
+// input: u, v = ends of the edge, node ids
+//        off = distance of the point from u along the edge, inflated as the weights
+//        K = top-K
+// output: as knn_query(), empty if there is no such edge. ids of a set of edge objects are indexes
+// into its edgeobjects
+// the point is reached from u at off and from v at the rest of the edge, so its knn are those of
+// aggregate_knn() from both ends with these offsets. objects on the same edge may be nearer along
+// it, K + their number are searched then and they take the nearer distance
+vector<ResultSet>& knn_edge_query( int u, int v, int off, int K, QueryContext &ctx = mainctx, int set = 0 ){
+	int w = edge_weight( u, v );
+	if ( w == -1 || off < 0 || off > w ){
+		ctx.rstset.clear();
+		return ctx.rstset;
+	}
+	if ( off == 0 ) return knn_query( u, K, ctx, set );
+	if ( off == w ) return knn_query( v, K, ctx, set );
+
+	// objects on the edge at their distance along it
+	const ObjectSet &objs = objectsets[set];
+	vector<ResultSet> onedge;
+	unordered_map< int, vector<int> >::const_iterator it = objs.endpoints.find( u );
+	if ( it != objs.endpoints.end() ){
+		for ( int i = 0; i < it->second.size(); i++ ){
+			const EdgeObject &o = objs.edgeobjects[it->second[i]];
+			int along = -1;
+			if ( o.snid == u && o.enid == v ) along = o.offset;
+			if ( o.snid == v && o.enid == u ) along = w - o.offset;
+			if ( along == -1 ) continue;
+			ResultSet rs = { it->second[i], abs( along - off ) };
+			onedge.push_back( rs );
+		}
+	}
+
+	vector<int> ends( 1, u ), offsets( 1, off );
+	ends.push_back( v );
+	offsets.push_back( w - off );
+	vector<ResultSet> &rstset = aggregate_knn( ends, K + onedge.size(), false, ctx, set, &offsets );
+	if ( onedge.size() == 0 ) return rstset;
+	for ( int i = 0; i < onedge.size(); i++ ){
+		int j = 0;
+		while( j < rstset.size() && rstset[j].id != onedge[i].id ) j++;
+		if ( j == rstset.size() ) rstset.push_back( onedge[i] );
+		else rstset[j].dis = min( rstset[j].dis, onedge[i].dis );
+	}
+	stable_sort( rstset.begin(), rstset.end(), []( const ResultSet &l, const ResultSet &r ){ return l.dis < r.dis; } );
+	if ( rstset.size() > K ) rstset.resize( K );
+	return rstset;
+}
+
+// distance from vertex v to its K+1-th nearest object, -1 if there are fewer objects
+// for an object vertex this is its K-th nearest other object, as v itself comes first
+// kept in the object set until its objects change, so later reverse knn queries reuse it
+int rknn_kth( int v, int K, QueryContext &ctx, int set ){
+	unordered_map<long long,int> &cache = objectsets[set].kth;
+	long long key = (long long)K * Nodes.size() + v;
+	unordered_map<long long,int>::iterator it = cache.find( key );
+	if ( it != cache.end() ) return it->second;
+	vector<ResultSet> &result = knn_query( v, K + 1, ctx, set );
+	int kth = result.size() > K ? result[K].dis : -1;
+	cache[key] = kth;
+	return kth;
+}
+
+// reverse knn search
+// input: locid = query location, node id
+//        K = top-K
+// output: a vector of ResultSet, (node id, distance from locid) of every object that would have locid
+//         among its K nearest: fewer than K other objects are strictly closer to it. ranked by distance
+// a vertex holding several objects counts as one. a subtree without locid is pruned when each of its
+// borders has K+1 objects closer than locid is: every object inside reaches locid through one of the
+// borders, and at least K of those are other objects closer to it. objects of the remaining leaves
+// are verified one by one. the knn distances of borders and objects are computed once per object
+// set and K(see rknn_kth()), the first queries pay for them
+// the result is kept in ctx until its next query
+vector<ResultSet>& reverse_knn( int locid, int K, QueryContext &ctx = mainctx, int set = 0 ){
+	const ObjectSet &objs = objectsets[set];
+	IntArray gtreepath = Nodes.gtreepath(locid);
+	vector<ResultSet> found;
+	vector<int> cands, dist;
+
+	// distances from locid are kept as the only location of aggregate_knn(), the knn queries of
+	// the checks use the rest of ctx
+	ctx.aggarena.resize( itm_offset.back() );
+	agg_upstream( ctx, 0, locid );
+
+	vector< pair<int,int> > stack( 1, make_pair( 0, 0 ) ); // tree node, depth
+	while( stack.size() > 0 ){
+		int tn = stack.back().first, d = stack.back().second;
+		stack.pop_back();
+
+		if ( GTree[tn].isleaf ){
+			const vector<int> &leafinvlist = objs.leafinvlist[tn];
+			cands.clear();
+			for ( int j = 0; j < leafinvlist.size(); j++ ){
+				cands.push_back( GTree[tn].leafnodes[leafinvlist[j]] );
+			}
+			if ( gtreepath.back() == tn ){
+				leaf_candidate( tn, locid, leafinvlist, cands, ctx, dist );
+			}
+			else{
+				const int *aitm = ctx.aggitm( 0, tn );
+				dist.resize( cands.size() );
+				for ( int j = 0; j < cands.size(); j++ ){
+					dist[j] = -1;
+					for ( int k = 0; k < GTree[tn].borders.size(); k++ ){
+						int dis = aitm[k] + GTree[tn].mind.at( k, leafinvlist[j] );
+						if ( dist[j] == -1 || dis < dist[j] ) dist[j] = dis;
+					}
+				}
+			}
+			// verify each object
+			for ( int j = 0; j < cands.size(); j++ ){
+				int dk = rknn_kth( cands[j], K, ctx, set );
+				if ( dk == -1 || dist[j] <= dk ){
+					ResultSet rs = { cands[j], dist[j] };
+					found.push_back( rs );
+				}
+			}
+			continue;
+		}
+
+		const vector<int> &nonleafinvlist = objs.nonleafinvlist[tn];
+		for ( int c = 0; c < nonleafinvlist.size(); c++ ){
+			int child = nonleafinvlist[c];
+			if ( gtreepath.size() > d + 1 && gtreepath[d+1] == child ){
+				stack.push_back( make_pair( child, d + 1 ) );
+				continue;
+			}
+			agg_child( ctx, 0, gtreepath, d, tn, child );
+			const int *aitm = ctx.aggitm( 0, child );
+			bool pruned = true;
+			for ( int j = 0; j < GTree[child].borders.size() && pruned; j++ ){
+				int dk = rknn_kth( GTree[child].borders[j], K, ctx, set );
+				pruned = dk != -1 && dk < aitm[j];
+			}
+			if ( pruned ) continue;
+			stack.push_back( make_pair( child, d + 1 ) );
+		}
+	}
+
+	sort( found.begin(), found.end(), []( const ResultSet &l, const ResultSet &r ){ return l.dis < r.dis || ( l.dis == r.dis && l.id < r.id ); } );
+	ctx.rstset.assign( found.begin(), found.end() );
+	return ctx.rstset;
+}
+
+// upstream of the batch locations ctx.locs[s, e), which share their gtreepath down to position i
+// tree node tn = gtreepath[i] is done for all of them at once, child group by child group: every
+// matrix entry of tn is read once for all locations below that child, whichever leaf they are in
+// output: the border distances of location x to tn are ctx.up[i][ctx.upbase[i][x] + j * ctx.upstride[i][x]],
+//         border by border, location by location
+void batch_upstream( QueryContext &ctx, int s, int e, int i ){
+	vector<int> &locs = ctx.locs;
+	int tn = Nodes.gtreepath(locs[s])[i], m = e - s, cid, posa, dis;
+	vector<int> &up = ctx.up[i];
+	int base = up.size();
+	up.resize( base + GTree[tn].borders.size() * m );
+	for ( int x = s; x < e; x++ ){
+		ctx.upbase[i][x] = base + x - s;
+		ctx.upstride[i][x] = m;
+	}
+
+	if ( GTree[tn].isleaf ){
+		for ( int x = 0; x < m; x++ ){
+			posa = leaf_pos( tn, locs[s + x] );
+			for ( int j = 0; j < GTree[tn].borders.size(); j++ ){
+				up[base + j * m + x] = GTree[tn].mind.at( j, posa );
+			}
+		}
+		return;
+	}
+
+	for ( int cs = s, ce; cs < e; cs = ce ){
+		cid = Nodes.gtreepath(locs[cs])[i+1];
+		for ( ce = cs; ce < e && Nodes.gtreepath(locs[ce])[i+1] == cid; ce++ );
+		batch_upstream( ctx, cs, ce, i + 1 );
+
+		int cm = ce - cs;
+		const int *child = &ctx.up[i+1][ctx.upbase[i+1][cs]];
+		for ( int j = 0; j < GTree[tn].borders.size(); j++ ){
+			int *row = &up[base + j * m + cs - s];
+			posa = GTree[tn].current_pos[j];
+			for ( int k = 0; k < GTree[cid].borders.size(); k++ ){
+				dis = GTree[tn].mind.at( posa, GTree[cid].up_pos[k] );
+				const int *c = child + k * cm;
+				for ( int x = 0; x < cm; x++ ){
+					if ( k == 0 || c[x] + dis < row[x] ){
+						row[x] = c[x] + dis;
+					}
+				}
+			}
+		}
+	}
+}
+
+// batch knn search
+// queries share the upstream pass wherever their gtreepaths do(batch_upstream()): queries in one
+// leaf share all of it, queries in sibling leaves the part above their father and so on, and
+// queries from one location share a single search with their largest K
+// input: locids, Ks = query locations and top-K, aligned
+// output: result of each query, the same as knn_query() returns
+vector< vector<ResultSet> > knn_batch( vector<int> &locids, vector<int> &Ks, QueryContext &ctx = mainctx, int set = 0 ){
+	vector< vector<ResultSet> > results( locids.size() );
+	if ( locids.size() == 0 ) return results;
+
+	// order by gtreepath(subtrees are contiguous), then location
+	vector<int> order( locids.size() );
+	for ( int i = 0; i < locids.size(); i++ ){
+		order[i] = i;
+	}
+	sort( order.begin(), order.end(), [&]( int l, int r ){
+		IntArray lp = Nodes.gtreepath(locids[l]), rp = Nodes.gtreepath(locids[r]);
+		if ( lp.back() != rp.back() ) return lexicographical_compare( lp.begin(), lp.end(), rp.begin(), rp.end() );
+		return locids[l] < locids[r] || ( locids[l] == locids[r] && l < r );
+	} );
+
+	// distinct locations
+	vector<int> &locs = ctx.locs, &maxk = ctx.maxk;
+	locs.clear();
+	maxk.clear();
+	int depth = 0;
+	for ( int i = 0; i < order.size(); i++ ){
+		int q = order[i];
+		if ( locs.size() == 0 || locs.back() != locids[q] ){
+			locs.push_back( locids[q] );
+			maxk.push_back( Ks[q] );
+			depth = max( depth, Nodes.gtreepath(locids[q]).size() );
+		}
+		else if ( Ks[q] > maxk.back() ){
+			maxk.back() = Ks[q];
+		}
+	}
+	int n = locs.size();
+
+	// shared upstream, as knn_upstream() for all locations at once, the root excluded
+	ctx.up.resize( depth );
+	ctx.upbase.resize( depth );
+	ctx.upstride.resize( depth );
+	for ( int i = 1; i < depth; i++ ){
+		ctx.up[i].clear();
+		ctx.upbase[i].resize( n );
+		ctx.upstride[i].resize( n );
+	}
+	for ( int s = 0, e; s < n && depth > 1; s = e ){
+		int tn = Nodes.gtreepath(locs[s])[1];
+		for ( e = s; e < n && Nodes.gtreepath(locs[e])[1] == tn; e++ );
+		batch_upstream( ctx, s, e, 1 );
+	}
+
+	// search each location, smaller K are prefixes of the largest
+	for ( int x = 0, i = 0; x < n; x++ ){
+		IntArray gtreepath = Nodes.gtreepath(locs[x]);
+		for ( int p = gtreepath.size() - 1; p > 0; p-- ){
+			int *dist = ctx.itm( gtreepath[p] );
+			const int *up = &ctx.up[p][ctx.upbase[p][x]];
+			int stride = ctx.upstride[p][x];
+			for ( int j = 0; j < GTree[gtreepath[p]].borders.size(); j++ ){
+				dist[j] = up[j * stride];
+			}
+		}
+		vector<ResultSet> &result = knn_search( locs[x], maxk[x], ctx, objectsets[set] );
+		for ( ; i < order.size() && locids[order[i]] == locs[x]; i++ ){
+			int q = order[i];
+			results[q].assign( result.begin(), result.begin() + ( Ks[q] < result.size() ? Ks[q] : result.size() ) );
+		}
+	}
+	return results;
+}
+
+// answer queries on threads threads, each with its own context, a chunk of queries at a time
+// batch > 0 answers each chunk of batch queries by knn_batch(), otherwise one by one
+// output: result of each query, in input order
+vector< vector<ResultSet> > knn_parallel( vector<int> &locids, vector<int> &Ks, int threads, int batch, int set = 0 ){
+	vector< vector<ResultSet> > results( locids.size() );
+	int chunk = batch > 0 ? batch : 64;
+	atomic<int> next( 0 );
+	auto work = [&](){
+		QueryContext ctx;
+		ctx.init();
+		vector<int> bl, bk;
+		int start;
+		while( ( start = next.fetch_add( chunk ) ) < (int)locids.size() ){
+			int end = min( (int)locids.size(), start + chunk );
+			if ( batch > 0 ){
+				bl.assign( locids.begin() + start, locids.begin() + end );
+				bk.assign( Ks.begin() + start, Ks.begin() + end );
+				vector< vector<ResultSet> > part = knn_batch( bl, bk, ctx, set );
+				for ( int i = start; i < end; i++ ){
+					results[i].swap( part[i - start] );
+				}
+			}
+			else{
+				for ( int i = start; i < end; i++ ){
+					results[i] = knn_query( locids[i], Ks[i], ctx, set );
+				}
+			}
+		}
+	};
+	vector<thread> workers;
+	for ( int i = 1; i < threads; i++ ){
+		workers.push_back( thread( work ) );
+	}
+	work();
+	for ( int i = 0; i < workers.size(); i++ ){
+		workers[i].join();
+	}
+	return results;
+}
+
+// apply edge weight changes to the graph, the distance matrices and the in-leaf distances of the
+// running index, between queries(no search may run meanwhile, live KnnIterators are void after it)
+// the kth distances cached for reverse_knn() are dropped, objects on a changed edge keep their
+// relative position on it
+// output: false if the index is compressed(gtree_build -c) or an edge does not exist(nothing is
+//         changed then)
+bool apply_updates( vector<EdgeUpdate> &updates ){
+	if ( updater.tree == NULL && ! updater.init( GTree, Nodes, leafdist.loaded() ? &leafdist : NULL ) ){
+		return false;
+	}
+	TIME_TICK_START
+	int entries = updater.apply( updates );
+	if ( entries == -1 ) return false;
+	TIME_TICK_END
+	for ( int s = 0; s < objectsets.size() && updater.changed > 0; s++ ){
+		ObjectSet &objs = objectsets[s];
+		objs.kth.clear();
+		for ( int i = 0; i < objs.edgeobjects.size(); i++ ){
+			EdgeObject &o = objs.edgeobjects[i];
+			if ( o.oid == -1 || o.snid == o.enid ) continue;
+			int weight = edge_weight( o.snid, o.enid );
+			if ( weight == o.weight ) continue;
+			o.offset = o.weight > 0 ? (long long)o.offset * weight / o.weight : 0;
+			o.weight = weight;
+		}
+	}
+	printf("UPDATE EDGES=%d CHANGED=%d ENTRIES=%d LEAF_ENTRIES=%d\n", (int)updates.size(), updater.changed, entries, updater.leafentries );
+	TIME_TICK_PRINT("UPDATE")
+	return true;
+}
+
+// apply edge weight changes of file, "snid enid weight" per line, weight as in FILE_EDGE
+// output: false if the file cannot be read or the changes cannot be applied, see apply_updates()
+bool update_weights( const char *file ){
+	FILE *fin = fopen( file, "r" );
+	if ( fin == NULL ){
+		printf("CANNOT OPEN %s\n", file);
+		return false;
+	}
+	vector<EdgeUpdate> updates;
+	EdgeUpdate e;
+	double weight;
+	while( fscanf( fin, "%d %d %lf", &e.snid, &e.enid, &weight ) == 3 ){
+		if ( e.snid >= 0 && e.snid < Nodes.size() && e.enid >= 0 && e.enid < Nodes.size() ){
+			e.snid = to_new( e.snid );
+			e.enid = to_new( e.enid );
+		}
+		e.weight = (int) (weight * WEIGHT_INFLATE_FACTOR );
+		updates.push_back(e);
+	}
+	fclose(fin);
+	return apply_updates( updates );
+}
+
+// file named by a query input line "update FILE", which applies its edge weight changes before
+// the queries that follow
+// output: NULL if line is not one
+const char* update_file( const char *line, char *file ){
+	if ( strncmp( line, "update ", 7 ) != 0 || sscanf( line + 7, "%255s", file ) != 1 ) return NULL;
+	return file;
+}
+
+// microsecond clock for benchmarks
+double time_us(){
+	struct timespec t;
+	clock_gettime( CLOCK_MONOTONIC, &t );
+	return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+// print average and percentiles of latencies(us)
+void print_latency( const char *name, vector<double> &latency ){
+	if ( latency.size() == 0 ) return;
+	sort( latency.begin(), latency.end() );
+	double sum = 0;
+	for ( int i = 0; i < latency.size(); i++ ){
+		sum += latency[i];
+	}
+	int n = latency.size();
+	printf("%s LATENCY(US) AVG=%.1f P50=%.1f P90=%.1f P99=%.1f MAX=%.1f\n", name, sum / n,
+		latency[n * 50 / 100], latency[n * 90 / 100], latency[n * 99 / 100], latency[n - 1] );
+}
+
+// knn benchmark on object set set, count queries from random locations, or from the vertices of
+// hotspots random leaves. threads > 1 or batch > 0 answers the same queries again by knn_parallel()
+void knn_benchmark( int count, int K, int batch, int hotspots, int threads, int set ){
+	srand( BENCH_SEED );
+	vector<int> locids, Ks( count, K ), spots;
+	for ( int i = 0; i < hotspots; i++ ){
+		spots.push_back( Nodes.gtreepath( rand() % Nodes.size() ).back() );
+	}
+	for ( int i = 0; i < count; i++ ){
+		if ( hotspots > 0 ){
+			IntArray leafnodes = GTree[spots[rand() % hotspots]].leafnodes;
+			locids.push_back( leafnodes[rand() % leafnodes.size()] );
+		}
+		else{
+			locids.push_back( to_new( rand() % Nodes.size() ) );
+		}
+	}
+
+	vector<double> latency;
+	long long checksum = 0;
+	mainctx.pq.reset_counters();
+	double start = time_us();
+	for ( int i = 0; i < count; i++ ){
+		double qstart = time_us();
+		vector<ResultSet> &result = knn_query( locids[i], K, mainctx, set );
+		latency.push_back( time_us() - qstart );
+		for ( int j = 0; j < result.size(); j++ ){
+			checksum += result[j].dis;
+		}
+	}
+	double total = time_us() - start;
+	printf("BENCH QUERIES=%d K=%d CHECKSUM=%lld\n", count, K, checksum);
+	print_latency( "KNN", latency );
+	QuadHeap<Status_query> &pq = mainctx.pq;
+	printf("KNN HEAP PER QUERY PUSHES=%.1f POPS=%.1f MOVES=%.1f\n", (double)pq.pushes / count, (double)pq.pops / count, (double)pq.moves / count );
+	if ( batch <= 0 && threads <= 1 ) return;
+	printf("KNN THROUGHPUT(QPS)=%.0f\n", count / total * 1e6 );
+
+	start = time_us();
+	vector< vector<ResultSet> > results = knn_parallel( locids, Ks, threads, batch, set );
+	total = time_us() - start;
+	long long parsum = 0;
+	for ( int q = 0; q < results.size(); q++ ){
+		for ( int j = 0; j < results[q].size(); j++ ){
+			parsum += results[q][j].dis;
+		}
+	}
+	printf("PARALLEL THREADS=%d BATCH=%d CHECKSUM=%lld THROUGHPUT(QPS)=%.0f\n", threads, batch, parsum, count / total * 1e6 );
+}
+
+// benchmark count knn queries from random locations asking for K objects and then more of them:
+// knn_query() with K and again with K + more, against one knn_iterator() taking K and then more
+// MISMATCH counts queries whose distances differ
+void more_benchmark( int count, int K, int more, int set ){
+	srand( BENCH_SEED );
+	vector<int> locids;
+	for ( int i = 0; i < count; i++ ){
+		locids.push_back( to_new( rand() % Nodes.size() ) );
+	}
+
+	vector<double> latency, again;
+	int mismatch = 0;
+	for ( int i = 0; i < count; i++ ){
+		double qstart = time_us();
+		knn_query( locids[i], K, mainctx, set );
+		vector<ResultSet> expect = knn_query( locids[i], K + more, mainctx, set );
+		again.push_back( time_us() - qstart );
+
+		qstart = time_us();
+		vector<ResultSet> found;
+		ResultSet rs;
+		KnnIterator it = knn_iterator( locids[i], mainctx, set );
+		while( found.size() < K && it.next( rs ) ){
+			found.push_back( rs );
+		}
+		while( found.size() < K + more && it.next( rs ) ){
+			found.push_back( rs );
+		}
+		latency.push_back( time_us() - qstart );
+
+		bool same = found.size() == expect.size();
+		for ( int j = 0; same && j < found.size(); j++ ){
+			same = found[j].dis == expect[j].dis;
+		}
+		if ( ! same ) mismatch ++;
+	}
+	printf("BENCH QUERIES=%d K=%d MORE=%d MISMATCH=%d\n", count, K, more, mismatch);
+	print_latency( "KNN ITERATOR", latency );
+	print_latency( "KNN AGAIN", again );
+}
+
+// benchmark count object moves in object set set, each takes a random object to a random vertex
+// queries run on the moved objects afterwards
+void move_benchmark( int count, int set ){
+	srand( BENCH_SEED );
+	ObjectSet &objs = objectsets[set];
+	vector<int> objects;
+	for ( int tn = 0; tn < GTree.size(); tn++ ){
+		for ( int i = 0; i < objs.leafinvlist[tn].size(); i++ ){
+			objects.insert( objects.end(), objs.leafcount[tn][i], GTree[tn].leafnodes[objs.leafinvlist[tn][i]] );
+		}
+	}
+	sort( objects.begin(), objects.end() );
+	if ( objects.size() == 0 ) return;
+
+	double start = time_us();
+	for ( int i = 0; i < count; i++ ){
+		int j = rand() % objects.size();
+		objs.remove( objects[j] );
+		objects[j] = rand() % Nodes.size();
+		objs.add( objects[j] );
+	}
+	double total = time_us() - start;
+	printf("MOVES=%d OBJECTS=%d THROUGHPUT(MOVES/S)=%.0f\n", count, (int)objects.size(), count / total * 1e6 );
+}
+
+// benchmark count range queries of radius R on object set set from random locations
+void range_benchmark( int count, int R, int set ){
+	srand( BENCH_SEED );
+	vector<int> locids;
+	for ( int i = 0; i < count; i++ ){
+		locids.push_back( to_new( rand() % Nodes.size() ) );
+	}
+
+	vector<double> latency;
+	long long checksum = 0, found = 0;
+	for ( int i = 0; i < count; i++ ){
+		double qstart = time_us();
+		vector<ResultSet> &result = range_query( locids[i], R, mainctx, set );
+		latency.push_back( time_us() - qstart );
+		found += result.size();
+		for ( int j = 0; j < result.size(); j++ ){
+			checksum += result[j].dis;
+		}
+	}
+	printf("BENCH QUERIES=%d RANGE=%d RESULTS(AVG)=%.1f CHECKSUM=%lld\n", count, R, (double)found / count, checksum);
+	print_latency( "RANGE", latency );
+}
+
+// benchmark count aggregate knn queries on object set set, each from group random locations
+void aggregate_benchmark( int count, int K, int group, bool aggmax, int set ){
+	srand( BENCH_SEED );
+	vector< vector<int> > groups( count );
+	for ( int i = 0; i < count; i++ ){
+		for ( int j = 0; j < group; j++ ){
+			groups[i].push_back( to_new( rand() % Nodes.size() ) );
+		}
+	}
+
+	vector<double> latency;
+	long long checksum = 0;
+	for ( int i = 0; i < count; i++ ){
+		double qstart = time_us();
+		vector<ResultSet> &result = aggregate_knn( groups[i], K, aggmax, mainctx, set );
+		latency.push_back( time_us() - qstart );
+		for ( int j = 0; j < result.size(); j++ ){
+			checksum += result[j].dis;
+		}
+	}
+	printf("BENCH QUERIES=%d K=%d GROUP=%d AGGREGATE=%s CHECKSUM=%lld\n", count, K, group, aggmax ? "MAX" : "SUM", checksum);
+	print_latency( "AGGREGATE", latency );
+}
+
+// network distance from the source of knn_path() to u, -1 if not reachable
+// gtreepath = that of the source, whose leaf the last dijkstra of ctx covers
+int path_distance( int u, IntArray &gtreepath, QueryContext &ctx ){
+	int d = ctx.dijkstra.settled( u );
+	if ( d != -1 ) return d;
+	IntArray upath = Nodes.gtreepath(u);
+	int leaf = upath.back();
+	if ( leaf == gtreepath.back() ) return -1;
+	// border distances of the tree nodes down to the leaf of u, as aggregate_knn() gets them
+	for ( int p = 1; p < upath.size(); p++ ){
+		if ( gtreepath.size() > p && gtreepath[p] == upath[p] ) continue;
+		if ( ctx.pathstamp[upath[p]] == ctx.pathepoch ) continue;
+		agg_child( ctx, 0, gtreepath, p - 1, upath[p-1], upath[p] );
+		ctx.pathstamp[upath[p]] = ctx.pathepoch;
+	}
+	const int *aitm = ctx.aggitm( 0, leaf );
+	int pos = leaf_pos( leaf, u ), dis;
+	for ( int k = 0; k < GTree[leaf].borders.size(); k++ ){
+		dis = aitm[k] + GTree[leaf].mind.at( k, pos );
+		if ( d == -1 || dis < d ) d = dis;
+	}
+	return d;
+}
+
+// shortest path retrieval, for the results a caller wants to show
+// input: locid = query location, v = target(e.g. a knn result), node ids
+// output: vertices of a shortest path from locid to v, empty if v is not reachable
+// walks back from v, each step to a neighbor u with d(locid, u) + w(u, v') = d(locid, v').
+// distances near locid come from a dijkstra until its leaf is settled, the others from the
+// border distances of their leaf(top-down from the upstream of locid) and the leaf matrix
+vector<int> knn_path( int locid, int v, QueryContext &ctx = mainctx ){
+	IntArray gtreepath = Nodes.gtreepath(locid);
+	vector<int> path;
+
+	ctx.aggarena.resize( itm_offset.back() );
+	agg_upstream( ctx, 0, locid );
+	ctx.pathepoch ++;
+	if ( ctx.pathepoch == 0 ){
+		ctx.pathstamp.assign( GTree.size(), 0 );
+		ctx.pathepoch = 1;
+	}
+	IntArray leafnodes = GTree[gtreepath.back()].leafnodes;
+	ctx.cands.assign( leafnodes.begin(), leafnodes.end() );
+	ctx.dijkstra.candidate( locid, ctx.cands, Nodes, ctx.result );
+
+	int dv = path_distance( v, gtreepath, ctx ), next, dnext, du;
+	if ( dv == -1 ) return path;
+	path.push_back( v );
+	while( v != locid ){
+		next = -1;
+		const int *adj = Nodes.adj( v ), *wgt = Nodes.wgt( v );
+		for ( int i = 0; i < Nodes.degree( v ) && next == -1; i++ ){
+			du = path_distance( adj[i], gtreepath, ctx );
+			if ( du == -1 || du + wgt[i] != dv ) continue;
+			// zero weight edges do not get closer, do not walk in circles on them
+			if ( wgt[i] == 0 && find( path.begin(), path.end(), adj[i] ) != path.end() ) continue;
+			next = adj[i];
+			dnext = du;
+		}
+		if ( next == -1 ){
+			path.clear();
+			return path;
+		}
+		path.push_back( next );
+		v = next;
+		dv = dnext;
+	}
+	reverse( path.begin(), path.end() );
+	return path;
+}
+
+// continuous knn along a route
+// input: route = vertices of a route, node ids, consecutive ones are adjacent as a rule
+//        K = top-K
+// output: split points, each the route position where the set of the K nearest objects changes and
+// the knn_query() result there, the first one is at position 0
+// the K+1-th nearest is searched too: moving a distance D changes no object distance by more than D,
+// so the set stays while 2D is below the gap of the K-th and K+1-th distances, the vertices before
+// that are neither searched nor get an upstream pass
+vector<RouteSplit> continuous_knn( vector<int> &route, int K, QueryContext &ctx = mainctx, int set = 0 ){
+	vector<RouteSplit> splits;
+	vector<int> current, ids; // sorted ids of the current set
+	long long moved = 0; // route distance since the last search
+	int gap = -1, w;
+	for ( int i = 0; i < route.size(); i++ ){
+		if ( i > 0 ){
+			// weight of the route edge, -1 if there is none, the bound is lost then
+			const int *adj = Nodes.adj( route[i-1] ), *wgt = Nodes.wgt( route[i-1] );
+			w = route[i-1] == route[i] ? 0 : -1;
+			for ( int p = 0; p < Nodes.degree( route[i-1] ); p++ ){
+				if ( adj[p] == route[i] && ( w == -1 || wgt[p] < w ) ) w = wgt[p];
+			}
+			if ( w == -1 ) gap = -1;
+			moved += w;
+			if ( gap != -1 && 2 * moved < gap ) continue;
+		}
+
+		knn_upstream( route[i], ctx );
+		vector<ResultSet> &result = knn_search( route[i], K + 1, ctx, objectsets[set] );
+		moved = 0;
+		if ( result.size() > K ){
+			gap = K > 0 ? result[K].dis - result[K-1].dis : INT_MAX;
+			result.pop_back();
+		}
+		else{
+			gap = INT_MAX;
+		}
+
+		ids.clear();
+		for ( int j = 0; j < result.size(); j++ ){
+			ids.push_back( result[j].id );
+		}
+		sort( ids.begin(), ids.end() );
+		if ( splits.size() > 0 && ids == current ) continue;
+		current.swap( ids );
+		RouteSplit split = { i, result };
+		splits.push_back( split );
+	}
+	return splits;
+}
+
+// reverse knn by brute force: a knn query from every object, for reverse_benchmark()
+vector<ResultSet> reverse_knn_brute( int locid, int K, int set ){
+	vector<ResultSet> found;
+	// distance from locid to every object
+	vector<ResultSet> all = range_query( locid, INT_MAX, mainctx, set );
+	for ( int i = 0; i < all.size(); i++ ){
+		vector<ResultSet> &result = knn_query( all[i].id, K + 1, mainctx, set );
+		if ( result.size() <= K || all[i].dis <= result[K].dis ){
+			found.push_back( all[i] );
+		}
+	}
+	sort( found.begin(), found.end(), []( const ResultSet &l, const ResultSet &r ){ return l.dis < r.dis || ( l.dis == r.dis && l.id < r.id ); } );
+	return found;
+}
+
+// benchmark count reverse knn queries on object set set from random locations, against brute force
+void reverse_benchmark( int count, int K, int set ){
+	srand( BENCH_SEED );
+	vector<int> locids;
+	for ( int i = 0; i < count; i++ ){
+		locids.push_back( to_new( rand() % Nodes.size() ) );
+	}
+
+	vector<double> latency, brute;
+	long long found = 0;
+	int mismatch = 0;
+	for ( int i = 0; i < count; i++ ){
+		double qstart = time_us();
+		vector<ResultSet> result = reverse_knn( locids[i], K, mainctx, set );
+		latency.push_back( time_us() - qstart );
+		qstart = time_us();
+		vector<ResultSet> expect = reverse_knn_brute( locids[i], K, set );
+		brute.push_back( time_us() - qstart );
+		found += result.size();
+		if ( result.size() != expect.size() ){
+			mismatch++;
+			continue;
+		}
+		for ( int j = 0; j < result.size(); j++ ){
+			if ( result[j].id != expect[j].id || result[j].dis != expect[j].dis ){
+				mismatch++;
+				break;
+			}
+		}
+	}
+	printf("BENCH QUERIES=%d K=%d RESULTS(AVG)=%.1f MISMATCH=%d\n", count, K, (double)found / count, mismatch);
+	print_latency( "RKNN", latency );
+	print_latency( "RKNN BRUTE", brute );
+}
+
+// benchmark continuous knn on count routes, each the shortest path between two random vertices,
+// against a knn query at every vertex of the route
+// MISMATCH counts routes whose split points or knn sets there differ
+void route_benchmark( int count, int K, int set ){
+	srand( BENCH_SEED );
+	vector< vector<int> > routes;
+	while( routes.size() < count ){
+		int s = to_new( rand() % Nodes.size() ), t = to_new( rand() % Nodes.size() );
+		vector<int> route = knn_path( s, t );
+		if ( route.size() > 0 ) routes.push_back( route );
+	}
+
+	vector<double> latency, brute;
+	long long vertices = 0, splitcount = 0;
+	int mismatch = 0;
+	for ( int i = 0; i < count; i++ ){
+		double qstart = time_us();
+		vector<RouteSplit> splits = continuous_knn( routes[i], K, mainctx, set );
+		latency.push_back( time_us() - qstart );
+		vertices += routes[i].size();
+		splitcount += splits.size();
+
+		qstart = time_us();
+		vector< vector<int> > sets;
+		vector<int> pos;
+		for ( int j = 0; j < routes[i].size(); j++ ){
+			vector<ResultSet> &result = knn_query( routes[i][j], K, mainctx, set );
+			vector<int> ids;
+			for ( int r = 0; r < result.size(); r++ ){
+				ids.push_back( result[r].id );
+			}
+			sort( ids.begin(), ids.end() );
+			if ( sets.size() > 0 && ids == sets.back() ) continue;
+			sets.push_back( ids );
+			pos.push_back( j );
+		}
+		brute.push_back( time_us() - qstart );
+
+		bool same = splits.size() == sets.size();
+		for ( int j = 0; same && j < splits.size(); j++ ){
+			vector<int> ids;
+			for ( int r = 0; r < splits[j].knn.size(); r++ ){
+				ids.push_back( splits[j].knn[r].id );
+			}
+			sort( ids.begin(), ids.end() );
+			same = splits[j].pos == pos[j] && ids == sets[j];
+		}
+		if ( ! same ) mismatch ++;
+	}
+	printf("BENCH ROUTES=%d K=%d VERTICES(AVG)=%.1f SPLITS(AVG)=%.1f MISMATCH=%d\n", count, K, (double)vertices / count, (double)splitcount / count, mismatch);
+	print_latency( "CKNN", latency );
+	print_latency( "CKNN EVERY VERTEX", brute );
+}
+
+// knn from a point on an edge by a dijkstra from each end over the ends of every object, for edge_benchmark()
+vector<ResultSet> knn_edge_brute( int u, int v, int off, int K, int set ){
+	const ObjectSet &objs = objectsets[set];
+	vector<EdgeObject> objects = objs.edgeobjects;
+	if ( objects.size() == 0 ){
+		for ( int tn = 0; tn < GTree.size(); tn++ ){
+			for ( int i = 0; i < objs.leafinvlist[tn].size(); i++ ){
+				int vertex = GTree[tn].leafnodes[objs.leafinvlist[tn][i]];
+				EdgeObject o = { vertex, vertex, vertex, 0, 0 };
+				objects.push_back( o );
+			}
+		}
+	}
+	vector<int> ends, fromu, fromv;
+	for ( int i = 0; i < objects.size(); i++ ){
+		ends.push_back( objects[i].snid );
+		ends.push_back( objects[i].enid );
+	}
+	int w = edge_weight( u, v );
+	mainctx.dijkstra.candidate( u, ends, Nodes, fromu );
+	mainctx.dijkstra.candidate( v, ends, Nodes, fromv );
+	vector<ResultSet> found;
+	for ( int i = 0; i < objects.size(); i++ ){
+		EdgeObject &o = objects[i];
+		if ( o.oid == -1 ) continue;
+		int dis = min( off + fromu[2*i], w - off + fromv[2*i] ) + o.offset;
+		dis = min( dis, min( off + fromu[2*i+1], w - off + fromv[2*i+1] ) + o.weight - o.offset );
+		if ( o.snid == u && o.enid == v ) dis = min( dis, abs( o.offset - off ) );
+		if ( o.snid == v && o.enid == u ) dis = min( dis, abs( w - o.offset - off ) );
+		ResultSet rs = { i, dis };
+		found.push_back( rs );
+	}
+	sort( found.begin(), found.end(), []( const ResultSet &l, const ResultSet &r ){ return l.dis < r.dis || ( l.dis == r.dis && l.id < r.id ); } );
+	if ( found.size() > K ) found.resize( K );
+	return found;
+}
+
+// benchmark count knn queries from random points on random edges against brute force
+// MISMATCH counts queries whose distances differ, SNAPPED those whose result(ids in rank order)
+// differs from a knn query at the nearer end of the edge
+void edge_benchmark( int count, int K, int set ){
+	srand( BENCH_SEED );
+	vector<int> us, vs, offs;
+	while( us.size() < count ){
+		int u = to_new( rand() % Nodes.size() );
+		if ( Nodes.degree( u ) == 0 ) continue;
+		int v = Nodes.adj( u )[rand() % Nodes.degree( u )], w = edge_weight( u, v );
+		us.push_back( u );
+		vs.push_back( v );
+		offs.push_back( w > 0 ? rand() % ( w + 1 ) : 0 );
+	}
+
+	vector<double> latency;
+	long long checksum = 0;
+	int mismatch = 0, snapped = 0;
+	for ( int i = 0; i < count; i++ ){
+		double qstart = time_us();
+		vector<ResultSet> result = knn_edge_query( us[i], vs[i], offs[i], K, mainctx, set );
+		latency.push_back( time_us() - qstart );
+		vector<ResultSet> brute = knn_edge_brute( us[i], vs[i], offs[i], K, set );
+		bool same = result.size() == brute.size();
+		for ( int j = 0; j < result.size(); j++ ){
+			checksum += result[j].dis;
+			if ( same && result[j].dis != brute[j].dis ) same = false;
+		}
+		if ( ! same ) mismatch ++;
+		int w = edge_weight( us[i], vs[i] );
+		vector<ResultSet> &snap = knn_query( 2 * offs[i] <= w ? us[i] : vs[i], K, mainctx, set );
+		same = snap.size() == result.size();
+		for ( int j = 0; same && j < snap.size(); j++ ){
+			same = snap[j].id == result[j].id;
+		}
+		if ( ! same ) snapped ++;
+	}
+	printf("BENCH QUERIES=%d K=%d CHECKSUM=%lld MISMATCH=%d SNAPPED=%d\n", count, K, checksum, mismatch, snapped);
+	print_latency( "EDGE KNN", latency );
+}
+
+// next query line from stdin, "locid K [set]", or "locid [set]" for range queries
+// set names an object set, defset is taken if there is none
+// update lines(see update_file()) are applied on the way, or returned in update if it is given
+// output: false at end of input, set = -1 if the named set does not exist,
+//         update = file of an update line(the query fields are not set then), or empty
+bool read_query( bool range, int defset, int &locid, int &K, int &set, char *update = NULL ){
+	char line[256], name[64], file[256];
+	int n, need = range ? 1 : 2;
+	if ( update != NULL ) update[0] = 0;
+	while( fgets( line, sizeof(line), stdin ) != NULL ){
+		if ( update_file( line, file ) != NULL ){
+			if ( update == NULL ){
+				update_weights( file );
+				continue;
+			}
+			strcpy( update, file );
+			return true;
+		}
+		n = range ? sscanf( line, "%d %63s", &locid, name ) : sscanf( line, "%d %d %63s", &locid, &K, name );
+		if ( n < need ) continue;
+		set = n > need ? object_set( name ) : defset;
+		if ( set == -1 ) printf("NO OBJECT SET %s\n", name);
+		return true;
+	}
+	return false;
+}
+
+int main( int argc, char **argv ){
+	// options
+	const char *file_index = FILE_GTREE_INDEX;
+	bool compress = false;
+	const char *file_update = NULL;
+	const char *kernel = NULL, *query_set = "default";
+	vector< pair<string, string> > object_files; // name, file
+	int bench = 0, bench_k = 10, batch = 0, hotspots = 0, threads = 1, range = -1, moves = 0, group = 4;
+	const char *aggregate = NULL;
+	bool reverse = false, continuous = false, onedge = false, use_leafdist = true;
+	int paths = 0, more = 0;
+	int opt;
+	while( ( opt = getopt( argc, argv, "i:cb:k:u:g:s:t:m:r:o:a:f:q:n:xp:wej:d" ) ) != -1 ){
+		switch( opt ){
+			case 'i':
+				file_index = optarg;
+				break;
+			case 'c':
+				compress = true;
+				break;
+			case 'b':
+				bench = atoi(optarg);
+				break;
+			case 'k':
+				bench_k = atoi(optarg);
+				break;
+			case 'u':
+				file_update = optarg;
+				break;
+			case 'g':
+				batch = atoi(optarg);
+				break;
+			case 's':
+				hotspots = atoi(optarg);
+				break;
+			case 't':
+				threads = atoi(optarg);
+				if ( threads < 1 ) threads = 1;
+				break;
+			case 'm':
+				kernel = optarg;
+				break;
+			case 'r':
+				range = atoi(optarg);
+				break;
+			case 'o':
+				moves = atoi(optarg);
+				break;
+			case 'a':
+				if ( strchr( optarg, '=' ) == NULL ){
+					printf("-a NEEDS name=file\n");
+					return 1;
+				}
+				object_files.push_back( make_pair( string( optarg, strchr( optarg, '=' ) ), string( strchr( optarg, '=' ) + 1 ) ) );
+				break;
+			case 'f':
+				query_set = optarg;
+				break;
+			case 'q':
+				aggregate = optarg;
+				if ( strcmp( aggregate, "sum" ) != 0 && strcmp( aggregate, "max" ) != 0 ){
+					printf("-q IS sum OR max\n");
+					return 1;
+				}
+				break;
+			case 'n':
+				group = atoi(optarg);
+				if ( group < 1 ) group = 1;
+				break;
+			case 'x':
+				reverse = true;
+				break;
+			case 'p':
+				paths = atoi(optarg);
+				break;
+			case 'w':
+				continuous = true;
+				break;
+			case 'e':
+				onedge = true;
+				break;
+			case 'j':
+				more = atoi(optarg);
+				break;
+			case 'd':
+				use_leafdist = false;
+				break;
+			default:
+				printf("USAGE: %s [-i index] [-c] [-b queries [-k K] [-s hotspots]] [-g batch] [-t threads] [-u updates] [-m kernel] [-r range] [-o moves] [-a name=file]... [-f name] [-q sum|max [-n group]] [-x] [-p paths] [-w] [-e] [-j more] [-d]\n", argv[0]);
+				printf("	-i single-file index, split files are used if it does not exist\n");
+				printf("	-c compress distance matrices when using split files\n");
+				printf("	-b run a benchmark of random knn queries instead of reading stdin\n");
+				printf("	-s draw benchmark queries from the vertices of this many random leaves\n");
+				printf("	-j benchmark asking for this many more objects after K, a knn iterator against a second query\n");
+				printf("	-g answer queries in batches of this size(knn_batch), the benchmark compares both\n");
+				printf("	-t answer queries on this many threads, the benchmark compares with one\n");
+				printf("	-u apply edge weight changes(\"snid enid weight\" per line) to the loaded index, later ones by \"update FILE\" query lines, not for a -c index\n");
+				printf("	-m min-plus kernel, scalar, avx2 or avx512, the best supported one by default\n");
+				printf("	-d do not use in-leaf distances(%s) even if present, search the query's leaf by dijkstra\n", FILE_LEAF_DIST);
+				printf("	-r answer range queries of this network distance(inflated weight) instead, stdin has a locid per line\n");
+				printf("	-o move this many random objects to random vertices before answering queries, and time it\n");
+				printf("	-a load another object set(category) from file, queries name it after locid and K\n");
+				printf("	   lines \"oid snid enid offset\" of a file are objects on edges, offset from snid as in .cedge\n");
+				printf("	-f object set of queries that name none, and of the benchmarks, default is default(%s)\n", FILE_OBJECT);
+				printf("	-q answer aggregate knn queries(\"K locid locid...\" per line), scored by the sum or max distance\n");
+				printf("	-n locations of each aggregate benchmark query, default 4\n");
+				printf("	-x answer reverse knn queries(\"locid K [set]\" per line), the benchmark compares with brute force\n");
+				printf("	-p print the shortest path to each of the first this many results of a knn query\n");
+				printf("	-w answer continuous knn queries along routes(\"K v v...\" per line), the benchmark compares with a query per vertex\n");
+				printf("	-e answer knn queries from points on edges(\"snid enid offset K [set]\" per line), the benchmark compares with brute force\n");
+				return 1;
+		}
+	}
+
+	// init
+	TIME_TICK_START
+	init();
+	TIME_TICK_END
+	TIME_TICK_PRINT("INIT")
+
+	// load index, map the single-file index in place, or convert the split files
+	TIME_TICK_START
+	long long len;
+	// copy-on-write, so edge weight changes can be applied while running
+	const char *base = index_map( file_index, len, true );
+	if ( base != NULL ){
+		printf("MAPPING INDEX %s...", file_index);
+		if ( index_check( base, len, Nodes.size() ) == NULL ) return 1;
+		printf("COMPLETE.\n");
+	}
+	else{
+		vector<TreeNodeFile> tree;
+
+		// load gtree index
+		gtree_load( tree );
+
+		// load distance matrix
+		hierarchy_shortest_path_load( tree );
+
+		// split files do not record build parameters, take what the tree shows
+		int fanout = tree.size() > 0 ? tree[0].children.size() : 0, leaf_cap = 0;
+		for ( int i = 0; i < tree.size(); i++ ){
+			if ( tree[i].isleaf && tree[i].leafnodes.size() > leaf_cap ) leaf_cap = tree[i].leafnodes.size();
+		}
+		index_build( tree, Nodes, vertex_order_load(), fanout, leaf_cap, compress, indeximage );
+		base = &indeximage[0];
+	}
+	index_attach( base, GTree, Nodes );
+	vector<int>().swap( Nodes.paths );
+	itm_layout();
+	pos_layout();
+	mainctx.init();
+	const int *order = index_order( base );
+	if ( order != NULL ){
+		vertex_new.assign( order, order + Nodes.size() );
+		vertex_old.resize( Nodes.size() );
+		for ( int i = 0; i < Nodes.size(); i++ ){
+			vertex_old[vertex_new[i]] = i;
+		}
+		Nodes.permute( vertex_new );
+	}
+	TIME_TICK_END
+	TIME_TICK_PRINT("LOAD")
+	const IndexHeader *header = (const IndexHeader*)base;
+	printf("INDEX FANOUT=%d LEAF_CAP=%d TREE_NODES=%d%s\n", header->fanout, header->leaf_cap, header->tree_count, header->renumbered ? " RENUMBERED" : "" );
+	printf("MIND BYTES=%lld%s\n", index_mind_bytes( base ), header->mind_compressed ? " (COMPRESSED)" : "" );
+	if ( file_update != NULL && header->mind_compressed ){
+		printf("-u NEEDS AN INDEX BUILT WITHOUT -c, COMPRESSED MATRICES CANNOT BE UPDATED\n");
+		return 1;
+	}
+	const char *kernel_name = minplus_select( kernel );
+	if ( kernel_name == NULL ){
+		printf("MINPLUS KERNEL %s IS NOT SUPPORTED\n", kernel);
+		return 1;
+	}
+	printf("MINPLUS KERNEL=%s%s\n", kernel_name, header->mind_compressed ? " (NOT USED, COMPRESSED)" : "" );
+
+	// in-leaf distances, copy-on-write as the index
+	if ( use_leafdist ){
+		long long leaflen;
+		const char *leafbase = index_map( FILE_LEAF_DIST, leaflen, true );
+		if ( leafbase != NULL ){
+			if ( ! leafdist_attach( leafbase, leaflen, GTree, Nodes, leafdist ) ) return 1;
+			printf("LEAF DISTANCES BYTES=%lld\n", leaflen );
+		}
+	}
+
+	// edge weight changes, matrices and in-leaf distances are rewritten in place
+	// later ones come as update lines between queries
+	if ( file_update != NULL ){
+		if ( ! update_weights( file_update ) ) return 1;
+	}
+
+	// pre query init
+	pre_query();
+	for ( int i = 0; i < object_files.size(); i++ ){
+		if ( object_set( object_files[i].first.c_str() ) != -1 ){
+			printf("OBJECT SET %s IS LOADED TWICE\n", object_files[i].first.c_str());
+			return 1;
+		}
+		if ( load_objects( object_files[i].first.c_str(), object_files[i].second.c_str() ) == -1 ) return 1;
+	}
+	int defset = object_set( query_set );
+	if ( defset == -1 ){
+		printf("NO OBJECT SET %s\n", query_set);
+		return 1;
+	}
+	if ( ( reverse || aggregate != NULL ) && ! objectsets[defset].edgeobjects.empty() ){
+		printf("OBJECT SET %s IS ON EDGES, %s QUERIES NEED VERTEX OBJECTS\n", query_set, reverse ? "REVERSE" : "AGGREGATE");
+		return 1;
+	}
+	if ( moves > 0 && ! objectsets[defset].edgeobjects.empty() ){
+		printf("OBJECT SET %s IS ON EDGES, OBJECT MOVES NEED VERTEX OBJECTS\n", query_set);
+		return 1;
+	}
+	if ( moves > 0 ){
+		move_benchmark( moves, defset );
+	}
+
+	if ( bench > 0 && more > 0 ){
+		more_benchmark( bench, bench_k, more, defset );
+		return 0;
+	}
+	if ( bench > 0 && onedge ){
+		edge_benchmark( bench, bench_k, defset );
+		return 0;
+	}
+	if ( bench > 0 && continuous ){
+		route_benchmark( bench, bench_k, defset );
+		return 0;
+	}
+	if ( bench > 0 && reverse ){
+		reverse_benchmark( bench, bench_k, defset );
+		return 0;
+	}
+	if ( bench > 0 && aggregate != NULL ){
+		aggregate_benchmark( bench, bench_k, group, strcmp( aggregate, "max" ) == 0, defset );
+		return 0;
+	}
+	if ( bench > 0 && range >= 0 ){
+		range_benchmark( bench, range, defset );
+		return 0;
+	}
+	if ( bench > 0 ){
+		knn_benchmark( bench, bench_k, batch, hotspots, threads, defset );
+		return 0;
+	}
+
+	// aggregate knn search
+	int locid, K, set;
+	char file[256];
+	vector<ResultSet> result;
+	if ( aggregate != NULL ){
+		printf("AGGREGATE Search Started...\n");
+		char line[4096], *p, *end;
+		vector<int> locids;
+		while( fgets( line, sizeof(line), stdin ) != NULL ){
+			if ( update_file( line, file ) != NULL ){
+				update_weights( file );
+				continue;
+			}
+			K = strtol( line, &end, 10 );
+			if ( end == line || K < 0 ) continue;
+			locids.clear();
+			for ( p = end; ( locid = strtol( p, &end, 10 ), end != p ); p = end ){
+				if ( locid >= 0 && locid < Nodes.size() ) locids.push_back( to_new(locid) );
+			}
+			if ( locids.size() == 0 ) continue;
+
+			TIME_TICK_START
+			result = aggregate_knn( locids, K, strcmp( aggregate, "max" ) == 0, mainctx, defset );
+			TIME_TICK_END
+			for ( int i = 0; i < result.size(); i++ ){
+				printf("ID=%d DIS=%d\n", to_old( result[i].id ), result[i].dis );
+			}
+			TIME_TICK_PRINT("AGGREGATE_SEARCH")
+		}
+		return 0;
+	}
+
+	// knn search from points on edges
+	if ( onedge ){
+		printf("EDGE KNN Search Started...\n");
+		char line[256], name[64];
+		int snid, enid, n;
+		double offset;
+		while( fgets( line, sizeof(line), stdin ) != NULL ){
+			if ( update_file( line, file ) != NULL ){
+				update_weights( file );
+				continue;
+			}
+			n = sscanf( line, "%d %d %lf %d %63s", &snid, &enid, &offset, &K, name );
+			if ( n < 4 ) continue;
+			set = n > 4 ? object_set( name ) : defset;
+			if ( set == -1 ) printf("NO OBJECT SET %s\n", name);
+			if ( snid >= Nodes.size() || snid < 0 || enid >= Nodes.size() || enid < 0 || K < 0 || set == -1 ) continue;
+
+			TIME_TICK_START
+			result = knn_edge_query( to_new(snid), to_new(enid), (int)( offset * WEIGHT_INFLATE_FACTOR ), K, mainctx, set );
+			TIME_TICK_END
+			for ( int i = 0; i < result.size(); i++ ){
+				printf("ID=%d DIS=%d\n", result_id( result[i].id, set ), result[i].dis );
+			}
+			TIME_TICK_PRINT("EDGE_KNN_SEARCH")
+		}
+		return 0;
+	}
+
+	// continuous knn search
+	if ( continuous ){
+		printf("CKNN Search Started...\n");
+		vector<char> line( 1 << 20 );
+		char *p, *end;
+		vector<int> route;
+		while( fgets( &line[0], line.size(), stdin ) != NULL ){
+			if ( update_file( &line[0], file ) != NULL ){
+				update_weights( file );
+				continue;
+			}
+			K = strtol( &line[0], &end, 10 );
+			if ( end == &line[0] || K < 0 || K > Nodes.size() ) continue;
+			route.clear();
+			for ( p = end; ( locid = strtol( p, &end, 10 ), end != p ); p = end ){
+				if ( locid >= 0 && locid < Nodes.size() ) route.push_back( to_new(locid) );
+			}
+			if ( route.size() == 0 ) continue;
+
+			TIME_TICK_START
+			vector<RouteSplit> splits = continuous_knn( route, K, mainctx, defset );
+			TIME_TICK_END
+			for ( int i = 0; i < splits.size(); i++ ){
+				printf("SPLIT=%d\n", splits[i].pos );
+				for ( int j = 0; j < splits[i].knn.size(); j++ ){
+					printf("ID=%d DIS=%d\n", result_id( splits[i].knn[j].id, defset ), splits[i].knn[j].dis );
+				}
+			}
+			TIME_TICK_PRINT("CKNN_SEARCH")
+		}
+		return 0;
+	}
+
+	// reverse knn search
+	if ( reverse ){
+		printf("RKNN Search Started...\n");
+		while( read_query( false, defset, locid, K, set ) ){
+			if (locid >= Nodes.size() || locid < 0 || K < 1 || set == -1 || ! objectsets[set].edgeobjects.empty()) continue;
+
+			TIME_TICK_START
+			result = reverse_knn( to_new(locid), K, mainctx, set );
+			TIME_TICK_END
+			for ( int i = 0; i < result.size(); i++ ){
+				printf("ID=%d DIS=%d\n", to_old( result[i].id ), result[i].dis );
+			}
+			TIME_TICK_PRINT("RKNN_SEARCH")
+		}
+		return 0;
+	}
+
+	// range search
+	if ( range >= 0 ){
+		printf("RANGE Search Started...\n");
+		while( read_query( true, defset, locid, K, set ) ){
+			if (locid >= Nodes.size() || locid < 0 || set == -1) continue;
+
+			TIME_TICK_START
+			result = range_query( to_new(locid), range, mainctx, set );
+			TIME_TICK_END
+			for ( int i = 0; i < result.size(); i++ ){
+				printf("ID=%d DIS=%d\n", result_id( result[i].id, set ), result[i].dis );
+			}
+			TIME_TICK_PRINT("RANGE_SEARCH")
+		}
+		return 0;
+	}
+
+	// knn search
+	// example
+	printf("KNN Search Started...\n");
+	if ( batch > 0 || threads > 1 ){
+		// read up to the end or an update line, answer on threads, print in input order
+		vector<int> locids, Ks, sets;
+		bool reading = true;
+		while( reading ){
+			locids.clear();
+			Ks.clear();
+			sets.clear();
+			while( ( reading = read_query( false, defset, locid, K, set, file ) ) && file[0] == 0 ){
+				if (locid >= Nodes.size() || locid < 0 || K < 0 || K > Nodes.size() || set == -1) continue;
+				locids.push_back( to_new(locid) );
+				Ks.push_back( K );
+				sets.push_back( set );
+			}
+			TIME_TICK_START
+			vector< vector<ResultSet> > results( locids.size() );
+			for ( int s = 0; s < objectsets.size(); s++ ){
+				vector<int> qs, ls, ks;
+				for ( int q = 0; q < locids.size(); q++ ){
+					if ( sets[q] != s ) continue;
+					qs.push_back( q );
+					ls.push_back( locids[q] );
+					ks.push_back( Ks[q] );
+				}
+				if ( qs.size() == 0 ) continue;
+				vector< vector<ResultSet> > part = knn_parallel( ls, ks, threads, batch, s );
+				for ( int i = 0; i < qs.size(); i++ ){
+					results[qs[i]].swap( part[i] );
+				}
+			}
+			TIME_TICK_END
+			for ( int q = 0; q < results.size(); q++ ){
+				for ( int j = 0; j < results[q].size(); j++ ){
+					printf("ID=%d DIS=%d\n", result_id( results[q][j].id, sets[q] ), results[q][j].dis );
+				}
+			}
+			printf("QUERIES=%d THREADS=%d BATCH=%d\n", (int)locids.size(), threads, batch );
+			TIME_TICK_PRINT("KNN_ALL")
+			if ( reading ) update_weights( file );
+		}
+		return 0;
+	}
+	while( read_query( false, defset, locid, K, set ) ){
+		if (locid >= Nodes.size() || locid < 0 || K < 0 || K > Nodes.size() || set == -1) continue;
+
+		TIME_TICK_START
+		result = knn_query( to_new(locid), K, mainctx, set );
+		TIME_TICK_END
+		for ( int i = 0; i < result.size(); i++ ){
+			printf("ID=%d DIS=%d\n", result_id( result[i].id, set ), result[i].dis );
+		}
+		TIME_TICK_PRINT("KNN_SEARCH")
+		if ( paths > 0 && objectsets[set].edgeobjects.empty() ){
+			TIME_TICK_START
+			vector< vector<int> > routes;
+			for ( int i = 0; i < result.size() && i < paths; i++ ){
+				routes.push_back( knn_path( to_new(locid), result[i].id ) );
+			}
+			TIME_TICK_END
+			for ( int i = 0; i < routes.size(); i++ ){
+				printf("PATH=");
+				for ( int j = 0; j < routes[i].size(); j++ ){
+					printf("%s%d", j > 0 ? "," : "", to_old( routes[i][j] ) );
+				}
+				printf("\n");
+			}
+			TIME_TICK_PRINT("KNN_PATH")
 		}
-		TIME_TICK_PRINT("KNN_SEARCH")
 	}
 
 	return 0;
@@ -0,0 +1,55 @@
+#!/bin/bash
+# gtree parameter tuning
+# builds one index per (fanout, leaf capacity) on a sample of a region and reports
+# build time, index size and knn latency percentiles of each
+# candidates are built in a scratch directory, the index files in DIR are not touched
+#
+# usage: ./gtree_tune.sh DIR [FANOUTS] [LEAF_CAPS] [QUERIES] [K] [THREADS]
+#   DIR       directory with the sample graph and objects (cal.cnode, cal.cedge, cal.object)
+#   FANOUTS   e.g. "2 4 8", default "4"
+#   LEAF_CAPS e.g. "16 32 64", default "16 32 64 128"
+#   QUERIES   random knn queries per index, default 10000
+#   K         default 10
+#   THREADS   build threads, default 1
+BIN=$(cd "$(dirname "$0")" && pwd)
+DIR="$1"
+FANOUTS=${2:-"4"}
+LEAF_CAPS=${3:-"16 32 64 128"}
+QUERIES=${4:-10000}
+K=${5:-10}
+THREADS=${6:-1}
+
+if [ -z "$DIR" ] || [ ! -f "$DIR/cal.cnode" ]; then
+	echo "usage: $0 DIR [FANOUTS] [LEAF_CAPS] [QUERIES] [K] [THREADS]"
+	exit 1
+fi
+DIR=$(cd "$DIR" && pwd) || exit 1
+
+# scratch directory with links to the inputs, gtree_build writes its files there
+WORK=$(mktemp -d) || exit 1
+trap 'rm -rf "$WORK"' EXIT
+for input in cal.cnode cal.cedge cal.cgraph cal.object; do
+	[ -f "$DIR/$input" ] && ln -s "$DIR/$input" "$WORK/$input"
+done
+cd "$WORK" || exit 1
+
+# the lists are split on whitespace here, every other expansion is quoted(paths may hold spaces)
+read -r -a FANOUT_LIST <<< "$FANOUTS"
+read -r -a LEAF_CAP_LIST <<< "$LEAF_CAPS"
+
+# times are printed in 0.01ms
+printf "%-6s %-8s %10s %10s %12s %10s %10s %10s %10s\n" FANOUT LEAF_CAP BUILD_MS MIND_MS INDEX_BYTES AVG_US P50_US P90_US P99_US
+for f in "${FANOUT_LIST[@]}"; do
+	for l in "${LEAF_CAP_LIST[@]}"; do
+		LOG="$DIR/tune_f${f}_l${l}.log"
+		GIDX="$DIR/tune_f${f}_l${l}.gidx"
+		"$BIN/gtree_build" -t "$THREADS" -f "$f" -l "$l" > "$LOG" || { echo "BUILD FAILED f=$f l=$l, see $LOG"; continue; }
+		mv cal.gidx "$GIDX"
+		"$BIN/gtree_query" -i "$GIDX" -b "$QUERIES" -k "$K" < /dev/null >> "$LOG"
+		BUILD=$(awk '/"BUILD" RESULT/ { print $3 / 100 }' "$LOG")
+		MIND=$(awk '/"MIND" RESULT/ { print $3 / 100 }' "$LOG")
+		SIZE=$(stat -c %s "$GIDX")
+		LAT=$(awk '/^KNN LATENCY/ { for ( i = 3; i <= 6; i++ ){ split( $i, kv, "=" ); printf "%10s ", kv[2] } }' "$LOG")
+		printf "%-6s %-8s %10s %10s %12s %s\n" "$f" "$l" "$BUILD" "$MIND" "$SIZE" "$LAT"
+	done
+done
@@ -0,0 +1,367 @@
+// incremental maintenance of the distance matrices for edge weight changes, used by gtree_query
+//
+// every matrix entry is a shortest path distance in the whole graph. with each changed edge at
+// the smaller of its old and new weight, let m(v) be the distance from v to the nearest endpoint
+// of changed edge (a, b) and w that weight, then entry (s, t) can only change if
+// m(s) + w + m(t) <= entry for some changed edge: an old shortest path took it, or a new shorter
+// one does, and the parts of that path before and after it are not shorter than m(s) and m(t).
+// changed edges are searched in groups, by the tree node holding them at the deepest level giving
+// at most UPDATE_GROUPS groups(a group tests its nearest endpoint and its smallest weight), and a
+// row is skipped if m(s) + w is above its largest entry.
+// entries passing the test are recomputed bottom up on the degenerated graph as
+// hierarchy_shortest_path_calculation() of gtree_build does, visiting only the tree nodes with
+// such an entry or a changed endpoint, and their ancestors. the degenerated adjacency of every
+// border of every tree node is kept, a node's is computed again only if its matrix or its
+// outward edges may have changed, the other nodes' borders keep theirs in the overlay graph.
+// matrices are written in place, so the index must be uncompressed and writable
+#ifndef GTREE_UPDATE_H
+#define GTREE_UPDATE_H
+
+#include<stdio.h>
+#include<vector>
+#include<algorithm>
+#include"gtree_graph.h"
+#include"gtree_dijkstra.h"
+#include"gtree_leafdist.h"
+using namespace std;
+
+#define UPDATE_GROUPS 64 // most searches from changed edges per update
+
+typedef struct{
+	int snid;
+	int enid;
+	int weight; // new weight, inflated as the graph weights
+}EdgeUpdate;
+
+// tree node type T holds IntArray fields and a DistMatrix mind, as attached by index_attach()
+template<class T>
+struct IndexUpdater{
+	vector<T> *tree;
+	Graph *graph;
+	LeafDist *leafdist; // in-leaf distances updated along, NULL if none
+	vector< vector<int> > levels; // tree nodes by depth
+	vector<int> allborders;
+	vector<int> bordertop; // depth of the shallowest tree node a vertex is a border of, -1 if none
+	vector< vector<int> > rowmax; // largest entry of each matrix row
+	vector< vector< vector<int> > > degnodes, degweight; // degenerated adjacency of each border of each tree node
+	vector< vector<char> > marks, leafmarks; // entries to recompute, row by row
+	Dijkstra near; // search from changed endpoints
+	Dijkstra engine; // row recomputation
+	OverlayGraph overlay; // as degenerated after the last update
+	// last apply(): number of edges whose weight changed, recomputed in-leaf entries
+	int changed, leafentries;
+
+	// scratch
+	vector<int> cand, result;
+
+	IndexUpdater(){ tree = NULL; graph = NULL; leafdist = NULL; changed = 0; leafentries = 0; }
+
+	// _leafdist = in-leaf distances to update along, NULL if none
+	// output: false if the distance matrices are compressed
+	bool init( vector<T> &_tree, Graph &_graph, LeafDist *_leafdist ){
+		if ( _tree.size() > 0 && _tree[0].mind.rows != NULL ){
+			printf("UPDATE: THE INDEX IS COMPRESSED(gtree_build -c), ONLY A PLAIN ONE CAN BE UPDATED\n");
+			return false;
+		}
+		tree = &_tree;
+		graph = &_graph;
+		leafdist = _leafdist;
+		vector<T> &t = *tree;
+
+		// level traversal
+		levels.clear();
+		vector<int> current( 1, 0 ), mid;
+		while( current.size() > 0 ){
+			levels.push_back( current );
+			mid.clear();
+			for ( int i = 0; i < current.size(); i++ ){
+				mid.insert( mid.end(), t[current[i]].children.begin(), t[current[i]].children.end() );
+			}
+			current.swap( mid );
+		}
+
+		bordertop.assign( graph->size(), -1 );
+		allborders.clear();
+		for ( int d = 0; d < levels.size(); d++ ){
+			for ( int j = 0; j < levels[d].size(); j++ ){
+				const IntArray &borders = t[levels[d][j]].borders;
+				for ( int k = 0; k < borders.size(); k++ ){
+					if ( bordertop[borders[k]] != -1 ) continue;
+					bordertop[borders[k]] = d;
+					allborders.push_back( borders[k] );
+				}
+			}
+		}
+
+		rowmax.assign( t.size(), vector<int>() );
+		marks.assign( t.size(), vector<char>() );
+		for ( int i = 0; i < t.size(); i++ ){
+			rowmax[i].assign( t[i].union_borders.size(), 0 );
+			for ( int k = 0; k < t[i].union_borders.size(); k++ ){
+				for ( int c = 0; c < t[i].mind.cols; c++ ){
+					rowmax[i][k] = max( rowmax[i][k], t[i].mind.at( k, c ) );
+				}
+			}
+			marks[i].assign( (long long)t[i].union_borders.size() * t[i].mind.cols, 0 );
+		}
+		leafmarks.assign( t.size(), vector<char>() );
+		for ( int i = 0; leafdist != NULL && i < t.size(); i++ ){
+			if ( t[i].isleaf ) leafmarks[i].assign( (long long)t[i].leafnodes.size() * t[i].leafnodes.size(), 0 );
+		}
+
+		// degenerate every level bottom up once, as gtree_build does
+		degnodes.assign( t.size(), vector< vector<int> >() );
+		degweight.assign( t.size(), vector< vector<int> >() );
+		overlay.init( *graph, allborders );
+		for ( int d = levels.size() - 1; d > 0; d-- ){
+			for ( int j = 0; j < levels[d].size(); j++ ){
+				degenerate( levels[d][j], d );
+			}
+		}
+
+		near.init( graph->size() );
+		engine.init( graph->size() );
+		return true;
+	}
+
+	// degenerate borders of tree node tn at depth d, as gtree_build does after each level,
+	// and keep their adjacency
+	void degenerate( int tn, int d ){
+		T &node = (*tree)[tn];
+		const IntArray &ub = node.union_borders;
+		const IntArray &col = node.isleaf ? node.leafnodes : node.union_borders;
+		int s, t, nid, row;
+
+		degnodes[tn].resize( node.borders.size() );
+		degweight[tn].resize( node.borders.size() );
+		for ( int k = 0; k < node.borders.size(); k++ ){
+			s = node.borders[k];
+			vector<int> &tnode = degnodes[tn][k], &tweight = degweight[tn][k];
+			tnode.clear();
+			tweight.clear();
+			// first, remove inward edges
+			for ( int p = 0; p < overlay.degree(s); p++ ){
+				nid = overlay.adj(s)[p];
+				IntArray gtreepath = overlay.gtreepath(nid);
+				if ( gtreepath.size() <= d || gtreepath[d] != tn ){
+					tnode.push_back( nid );
+					tweight.push_back( overlay.wgt(s)[p] );
+				}
+			}
+			// second, add inter connected edges
+			row = lower_bound( ub.begin(), ub.end(), s ) - ub.begin();
+			for ( int p = 0; p < node.borders.size(); p++ ){
+				if ( k == p ) continue;
+				t = node.borders[p];
+				tnode.push_back( t );
+				tweight.push_back( node.mind.at( row, lower_bound( col.begin(), col.end(), t ) - col.begin() ) );
+			}
+			overlay.replace( s, tnode, tweight );
+		}
+	}
+
+	// degenerate borders of tree node tn with the adjacency kept by degenerate()
+	void reuse( int tn ){
+		T &node = (*tree)[tn];
+		for ( int k = 0; k < node.borders.size(); k++ ){
+			overlay.replace( node.borders[k], degnodes[tn][k], degweight[tn][k] );
+		}
+	}
+
+	// mark the entries the changed edges near holds may affect, w = their smallest weight
+	void mark( int w ){
+		vector<T> &t = *tree;
+		for ( int tn = 0; tn < t.size(); tn++ ){
+			T &node = t[tn];
+			const IntArray &col = node.isleaf ? node.leafnodes : node.union_borders;
+			for ( int k = 0; k < node.union_borders.size(); k++ ){
+				int ms = near.settled( node.union_borders[k] );
+				if ( ms == -1 || (long long)ms + w > rowmax[tn][k] ) continue;
+				char *flag = &marks[tn][(long long)k * node.mind.cols];
+				for ( int c = 0; c < col.size(); c++ ){
+					int mt = near.settled( col[c] );
+					if ( mt != -1 && (long long)ms + w + mt <= node.mind.at( k, c ) ){
+						flag[c] = 1;
+					}
+				}
+			}
+		}
+		if ( leafdist != NULL ){
+			leafdist_mark( *leafdist, t, near, w, leafmarks );
+		}
+	}
+
+	// recompute the marked entries of tree node tn and clear their marks
+	// the matrix of a non-leaf node is symmetric(undirected graph), each pair is searched once
+	// output: number of recomputed entries
+	int recompute( int tn ){
+		T &node = (*tree)[tn];
+		const IntArray &col = node.isleaf ? node.leafnodes : node.union_borders;
+		int *mind = (int*)node.mind.data, cols = node.mind.cols, entries = 0;
+		for ( int k = 0; k < node.union_borders.size(); k++ ){
+			char *flag = &marks[tn][(long long)k * cols];
+			cand.clear();
+			for ( int c = node.isleaf ? 0 : k + 1; c < col.size(); c++ ){
+				if ( flag[c] ) cand.push_back( col[c] );
+			}
+			if ( cand.size() == 0 ) continue;
+			engine.candidate( node.union_borders[k], cand, overlay, result );
+			for ( int c = node.isleaf ? 0 : k + 1, r = 0; c < col.size(); c++ ){
+				if ( ! flag[c] ) continue;
+				mind[(long long)k * cols + c] = result[r];
+				if ( ! node.isleaf ){
+					mind[(long long)c * cols + k] = result[r];
+					entries ++;
+				}
+				r ++;
+			}
+			entries += cand.size();
+		}
+		fill( marks[tn].begin(), marks[tn].end(), 0 );
+		for ( int k = 0; entries > 0 && k < node.union_borders.size(); k++ ){
+			rowmax[tn][k] = *max_element( mind + (long long)k * cols, mind + (long long)( k + 1 ) * cols );
+		}
+		return entries;
+	}
+
+	// apply new edge weights to the graph, the distance matrices and the in-leaf distances
+	// output: number of recomputed matrix entries, -1 if an edge does not exist(nothing is changed then)
+	int apply( vector<EdgeUpdate> &updates ){
+		vector<T> &t = *tree;
+
+		// changed edges and their old weights
+		vector<int> edges, old;
+		changed = 0;
+		leafentries = 0;
+		for ( int i = 0; i < updates.size(); i++ ){
+			EdgeUpdate &e = updates[i];
+			if ( e.snid < 0 || e.snid >= graph->size() || e.enid < 0 || e.enid >= graph->size() ){
+				printf("UPDATE: NO EDGE (%d, %d)\n", e.snid, e.enid);
+				return -1;
+			}
+			const int *adj = graph->adj( e.snid ), *wgt = graph->wgt( e.snid );
+			int deg = graph->degree( e.snid ), p = find( adj, adj + deg, e.enid ) - adj;
+			if ( p == deg ){
+				printf("UPDATE: NO EDGE (%d, %d)\n", e.snid, e.enid);
+				return -1;
+			}
+			if ( wgt[p] != e.weight ){
+				edges.push_back( i );
+				old.push_back( wgt[p] );
+			}
+		}
+		if ( edges.size() == 0 ) return 0;
+		changed = edges.size();
+
+		// groups: the tree node holding snid, at the deepest level giving at most UPDATE_GROUPS
+		vector<int> group( edges.size() ), keys;
+		for ( int d = 0; d < levels.size(); d++ ){
+			keys.clear();
+			for ( int i = 0; i < edges.size(); i++ ){
+				IntArray gtreepath = graph->gtreepath( updates[edges[i]].snid );
+				keys.push_back( gtreepath[min( d, gtreepath.size() - 1 )] );
+			}
+			sort( keys.begin(), keys.end() );
+			keys.erase( unique( keys.begin(), keys.end() ), keys.end() );
+			if ( d > 0 && keys.size() > UPDATE_GROUPS ) break;
+			for ( int i = 0; i < edges.size(); i++ ){
+				IntArray gtreepath = graph->gtreepath( updates[edges[i]].snid );
+				group[i] = lower_bound( keys.begin(), keys.end(), gtreepath[min( d, gtreepath.size() - 1 )] ) - keys.begin();
+			}
+		}
+		int groups = *max_element( group.begin(), group.end() ) + 1;
+
+		// search with every changed edge at its smaller weight, as far as any entry reaches
+		int radius = 0;
+		for ( int i = 0; i < t.size(); i++ ){
+			for ( int k = 0; k < rowmax[i].size(); k++ ){
+				radius = max( radius, rowmax[i][k] );
+			}
+		}
+		if ( leafdist != NULL ){
+			radius = max( radius, leafdist_max( *leafdist, t ) );
+		}
+		for ( int i = 0; i < edges.size(); i++ ){
+			EdgeUpdate &e = updates[edges[i]];
+			graph->set_weight( e.snid, e.enid, min( old[i], e.weight ) );
+		}
+		vector<int> sources;
+		for ( int g = 0; g < groups; g++ ){
+			sources.clear();
+			int w = -1;
+			for ( int i = 0; i < edges.size(); i++ ){
+				if ( group[i] != g ) continue;
+				EdgeUpdate &e = updates[edges[i]];
+				sources.push_back( e.snid );
+				sources.push_back( e.enid );
+				if ( w == -1 || min( old[i], e.weight ) < w ) w = min( old[i], e.weight );
+			}
+			near.bounded( sources, *graph, radius - w );
+			mark( w );
+		}
+
+		// new weights
+		for ( int i = 0; i < edges.size(); i++ ){
+			graph->set_weight( updates[edges[i]].snid, updates[edges[i]].enid, updates[edges[i]].weight );
+		}
+
+		// tree nodes whose degenerated adjacency may change: those with a marked entry or an endpoint,
+		// visited with their ancestors
+		vector<char> redo( t.size(), 0 ), visit( t.size(), 0 );
+		for ( int i = 0; i < t.size(); i++ ){
+			if ( find( marks[i].begin(), marks[i].end(), 1 ) != marks[i].end() ) redo[i] = 1;
+		}
+		for ( int i = 0; i < edges.size(); i++ ){
+			EdgeUpdate &e = updates[edges[i]];
+			IntArray spath = graph->gtreepath( e.snid ), epath = graph->gtreepath( e.enid );
+			for ( int d = 0; d < spath.size(); d++ ) redo[spath[d]] = 1;
+			for ( int d = 0; d < epath.size(); d++ ) redo[epath[d]] = 1;
+		}
+		for ( int i = 0; i < t.size(); i++ ){
+			for ( int tn = i; redo[i] && tn != -1 && ! visit[tn]; tn = t[tn].father ){
+				visit[tn] = 1;
+			}
+		}
+
+		// borders of visited nodes fall back to the shallowest node below them not visited,
+		// or to their own adjacency
+		vector<int> fallback;
+		for ( int i = 0; i < t.size(); i++ ){
+			if ( visit[i] ) fallback.insert( fallback.end(), t[i].borders.begin(), t[i].borders.end() );
+		}
+		sort( fallback.begin(), fallback.end() );
+		fallback.erase( unique( fallback.begin(), fallback.end() ), fallback.end() );
+		for ( int i = 0; i < fallback.size(); i++ ){
+			int v = fallback[i], d = bordertop[v];
+			IntArray gtreepath = graph->gtreepath( v );
+			while( d < gtreepath.size() && visit[gtreepath[d]] ) d++;
+			if ( d == gtreepath.size() ){
+				overlay.restore( v );
+				continue;
+			}
+			const IntArray &borders = t[gtreepath[d]].borders;
+			int k = find( borders.begin(), borders.end(), v ) - borders.begin();
+			overlay.replace( v, degnodes[gtreepath[d]][k], degweight[gtreepath[d]][k] );
+		}
+
+		// bottom up recomputation
+		int entries = 0;
+		for ( int d = levels.size() - 1; d >= 0; d-- ){
+			for ( int j = 0; j < levels[d].size(); j++ ){
+				if ( visit[levels[d][j]] ) entries += recompute( levels[d][j] );
+			}
+			// degenerate before the level above
+			for ( int j = 0; d > 0 && j < levels[d].size(); j++ ){
+				int tn = levels[d][j];
+				if ( redo[tn] ) degenerate( tn, d );
+				else if ( visit[tn] ) reuse( tn );
+			}
+		}
+		if ( leafdist != NULL ){
+			leafentries = leafdist_recompute( *leafdist, t, *graph, leafmarks, engine );
+		}
+		return entries;
+	}
+};
+
+#endif
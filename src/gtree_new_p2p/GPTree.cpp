@@ -11,6 +11,7 @@
 #include<queue>
 #include<sys/time.h>
 #include<metis.h>
+#include"../cgraph/cgraph.h"
 int times[10];//辅助计时变量；
 int cnt_type0,cnt_type1;
 
@@ -21,6 +22,7 @@ const bool Optimization_KNN_Cut=true;//是否开启KNN剪枝查询算法
 const bool Optimization_Euclidean_Cut=false;//是否开启Catch查询中基于欧几里得距离剪枝算法
 const char Edge_File[]="COL.edge";//第一行两个整数n,m表示点数和边数，接下来m行每行三个整数U,V,C表示U->V有一条长度为C的边
 const char Node_File[]="NY_.co";//共N行每行一个整数两个实数id,x,y表示id结点的经纬度(但输入不考虑id，只顺序从0读到n-1，整数N在Edge文件里)
+const char Graph_File[]="COL.cgraph";//cgraph_convert -d转换得到的二进制图文件，存在时代替Edge_File和Node_File读入(无-d转换的无向.cedge图不接受)
 const int Global_Scheduling_Cars_Per_Request=30000000;//每次规划精确计算前至多保留的车辆数目(时间开销)
 const double Unit=0.1;//路网文件的单位长度/m
 const double R_earth=6371000.0;//地球半径，用于输入经纬度转化为x,y坐标
@@ -2366,6 +2368,30 @@ void init()
 void read()
 {
 	printf("begin read\n");
+	if(cgraph_exists(Graph_File))//二进制图文件，一次映射读入，文件存在但无效时报错退出
+	{
+		CGraph cg;
+		if(!cgraph_open(Graph_File,cg))exit(1);
+		if(!cg.directed)//无向图来自.cedge，边权是实数，取整后不可用
+		{
+			printf("%s IS AN UNDIRECTED GRAPH, GPTREE NEEDS ONE CONVERTED BY cgraph_convert -d FROM %s\n",Graph_File,Edge_File);
+			cgraph_close(cg);
+			exit(1);
+		}
+		G.init(cg.node_count,cg.edge_count);
+		for(int i=0;i<G.n;i++)G.id[i]=i;
+		for(int i=0;i<cg.edge_count;i++)
+		{
+			int c=(int)(cg.edges[i].weight+0.5);
+			if(RevE==false)G.add_D(cg.edges[i].snid,cg.edges[i].enid,c);//单向边
+			else G.add(cg.edges[i].snid,cg.edges[i].enid,c);//双向边
+		}
+		if(Optimization_Euclidean_Cut)
+			for(int i=0;i<G.n;i++)coordinate.push_back(coor(cg.xy[2*i],cg.xy[2*i+1]));
+		cgraph_close(cg);
+		printf("read over\n");
+		return;
+	}
 	FILE *in=NULL;
 	in=fopen(Edge_File,"r");
 	cout<<"correct1"<<endl;
@@ -0,0 +1,172 @@
+/* ----------------------------------------------------------------------------
+    Author: Ken C. K. Lee
+    Email:  cklee@cse.psu.edu
+    Web:    http://www.cse.psu.edu/~cklee
+    Date:   Jan, 2008
+
+    Copyright(c) Ken C. K. Lee 2008
+    This program is for non-commerical use only.
+
+    This program performs range search on objects, on the same test file as
+    hiernn_gtree, to compare with range_query() of gtree_query.
+
+    Suggested arguments:
+    > (prog name) -h hiergraph.idx -x testFile -r range
+    explanations:
+    -h: hiergraph index file (input)
+    -x: test file, num_obj, the object vertices, num_query, the query vertices
+    -r: range, network distance in edge weights of the graph file
+        (gtree_query -r takes it times WEIGHT_INFLATE_FACTOR)
+    -v: print each result (default: off)
+---------------------------------------------------------------------------- */
+
+#include "hiergraph.h"
+#include "bordernode.h"
+#include "shortcuttreenode.h"
+#include "segfmem.h"
+#include "param.h"
+#include "collection.h"
+#include "nodemap.h"
+#include "graphmap.h"
+#include "graphsearch.h"
+#include "hierobjsearch.h"
+#include "access.h"
+#include "iomeasure.h"
+#include <sys/types.h>
+#include <sys/timeb.h>
+#include <sys/time.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <iostream>
+#include <vector>
+#include <fstream>
+
+using namespace std;
+
+struct timeval tv;
+long ts, te;
+//Stop Watch for us
+#define TIME_TICK_START gettimeofday( &tv, NULL ); ts = tv.tv_sec * 1000000 + tv.tv_usec ;
+#define TIME_TICK_END gettimeofday( &tv, NULL ); te = tv.tv_sec * 1000000 + tv.tv_usec ;
+#define TIME_TICK_DIFF te - ts;
+#define PAGESIZE 409600000
+
+void helpmsg(const char* pgm)
+{
+    cerr << "Suggested arguments for range search test road:" << endl;
+    cerr << "> " << pgm << " ";
+    cerr << "-h graph.idx -x testFile -r distance -v" << endl;
+    cerr << "explanations:" << endl;
+    cerr << "-h: hiergraph index file" << endl;
+    cerr << "-x: test file (objects and query vertices)" << endl;
+    cerr << "-r: range, in edge weights of the graph file" << endl;
+    cerr << "-v: print each result (default: off)" << endl;
+}
+
+int main(const int a_argc, const char** a_argv)
+{
+    if (a_argc == 1)
+    {
+        helpmsg(a_argv[0]);
+        return -1;
+    }
+
+    cerr << "range object search on hierarchical graph" << endl;
+    //-------------------------------------------------------------------------
+    // initialization
+    //-------------------------------------------------------------------------
+    const char* hidxflname = Param::read(a_argc, a_argv, "-h", "");
+    const char* FILE_OBJECT = Param::read(a_argc, a_argv, "-x", "");
+    const char* crange = Param::read(a_argc, a_argv, "-r", "");
+    const char* vrbs = Param::read(a_argc, a_argv, "-v", "null");
+    bool verbose = strcmp(vrbs,"null") != 0;
+    float range = (float)atof(crange);
+
+    //-------------------------------------------------------------------------
+    // access graph index file
+    //-------------------------------------------------------------------------
+    cerr << "loading a graph index ... ";
+    SegFMemory segmem(hidxflname, PAGESIZE, PAGESIZE, 32, false);
+    HierGraph hiergraph(segmem);
+    cerr << "[DONE]" << endl;
+
+    //-------------------------------------------------------------------------
+    // objects
+    //-------------------------------------------------------------------------
+    FILE* fin = fopen(FILE_OBJECT, "r");
+    if (fin == NULL)
+    {
+        cerr << "cannot open " << FILE_OBJECT << endl;
+        return -1;
+    }
+    int num_obj;
+    fscanf(fin, "%d", &num_obj);
+    cout << "Numobj:" << num_obj << endl;
+
+    NodeMapping nmap;
+    GraphMapping gmap;
+    long long pre_time;
+    TIME_TICK_START
+    for (int j = 0; j < num_obj; j ++){
+        int nodeid, objid;
+        fscanf(fin, "%d", &nodeid);
+        objid = j;
+
+        nmap.addObject(nodeid, objid);
+        BorderNode* bnode = hiergraph.getBorderNode(nodeid);
+
+        Array* a = &bnode->m_shortcuttree;
+        while (a->size() > 0)
+        {
+            ShortcutTreeNode* s = (ShortcutTreeNode*)a->get(0);
+            if (s->m_subnetid == 0) break;
+            gmap.addObject(s->m_subnetid, objid);
+            a = &s->m_child;
+        }
+    }
+    TIME_TICK_END
+    pre_time = TIME_TICK_DIFF
+
+    //-------------------------------------------------------------------------
+    // search
+    //-------------------------------------------------------------------------
+    int num_ql, locid;
+    fscanf(fin, "%d", &num_ql);
+    cout << "RANGE:" << range << "\tNUM_QL:" << num_ql << endl;
+
+    long long all_time = 0, found = 0;
+    for (int j = 0; j < num_ql; j ++){
+        fscanf(fin, "%d", &locid);
+        Array result;
+        int nodeaccess=0;
+        int edgeaccess=0;
+        segmem.m_history.clean();
+
+        TIME_TICK_START
+        HierObjectSearch::rangeSearch(hiergraph,nmap,gmap,locid,range,result,nodeaccess,edgeaccess);
+        TIME_TICK_END
+        all_time += TIME_TICK_DIFF
+
+        //----------------------------------------------------------------------
+        // result clean up
+        //----------------------------------------------------------------------
+        for (int i=0; i<result.size(); i++)
+        {
+            ObjectSearchResult* r = (ObjectSearchResult*)result.get(i);
+            found += r->m_objects.size();
+            if (verbose)
+                cout << locid << ":" << r->m_nid << "," << r->m_cost << endl;
+            delete r;
+        }
+    }
+    fclose(fin);
+
+    if (num_ql > 0)
+        printf("Pre_time\t%lld\t AveTime:\t%lld\t AveResult:\t%.1f   (us)\r\n", pre_time, all_time / num_ql, (double)found / num_ql);
+
+    //-------------------------------------------------------------------------
+    // all done
+    //-------------------------------------------------------------------------
+    return 0;
+}
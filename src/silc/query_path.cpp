@@ -12,6 +12,7 @@
 #include<deque>
 #include<stack>
 #include<algorithm>
+#include"../cgraph/cgraph.h"
 #include<sys/time.h>
 using namespace std;
 
@@ -24,6 +25,7 @@ long ts, te;
 // ----------
 
 #define FILE_NODE "../../src/data/col.cnode"
+#define FILE_GRAPH "../../src/data/col.cgraph" // binary graph of cgraph_convert, used instead of the text files if present
 // cal=10000 SF=NA=100 ny=100000 e=100000 col=100000
 
 #define FILE_PATH "../../common_data/col.path.Q4.dat"
@@ -48,14 +50,15 @@ void init_input(){
 
 	// load node
 	printf("LOADING NODE...");
-	fin = fopen(FILE_NODE,"r");
-	int nid;
+	CGraph cg;
+	if ( ! cgraph_load( FILE_GRAPH, FILE_NODE, NULL, cg ) ) exit(1);
 	double x,y;
-	while( fscanf(fin, "%d %lf %lf", &nid, &x, &y ) == 3 ){
+	for ( int nid = 0; nid < cg.node_count; nid++ ){
+		x = cg.xy[2 * nid]; y = cg.xy[2 * nid + 1];
 		Node node = { x, y };
 		Nodes.push_back(node);
 	}
-	fclose(fin);
+	cgraph_close( cg );
 	printf("COMPLETE. NODE_COUNT=%d\n", Nodes.size());
 
 	// load edge
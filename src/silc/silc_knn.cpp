@@ -25,6 +25,7 @@
 #include<stack>
 
 #include<algorithm>
+#include"../cgraph/cgraph.h"
 
 #include<sys/time.h>
 
@@ -144,21 +145,21 @@ double max_urx, max_ury;
 
 void init_input(){
 
-	FILE *fin;
-
-
-
 	// load node
 
 	printf("LOADING NODE...");
 
-	fin = fopen(FILE_NODE,"r");
+	CGraph cg;
 
-	int nid;
+	bool loaded = cgraph_is_binary( FILE_NODE ) ? cgraph_open( FILE_NODE, cg ) : cgraph_load_text( FILE_NODE, FILE_EDGE, cg );
+
+	if ( ! loaded ) exit(1);
 
 	double x,y;
 
-	while( fscanf(fin, "%d %lf %lf", &nid, &x, &y ) == 3 ){
+	for ( int nid = 0; nid < cg.node_count; nid++ ){
+
+		x = cg.xy[2 * nid]; y = cg.xy[2 * nid + 1];
 
 		Node node = { x * WEIGHT_INFLATE_FACTOR, y * WEIGHT_INFLATE_FACTOR };
 
@@ -166,8 +167,6 @@ void init_input(){
 
 	}
 
-	fclose(fin);
-
 	printf("COMPLETE. NODE_COUNT=%d\n", Nodes.size());
 
 
@@ -176,17 +175,15 @@ void init_input(){
 
 	printf("LOADING EDGE...");
 
-	fin = fopen(FILE_EDGE, "r");
-
-	int eid;
-
 	int snid, enid;
 
 	double weight;
 
 	int iweight;
 
-	while( fscanf(fin,"%d %d %d %lf", &eid, &snid, &enid, &weight ) == 4 ){
+	for ( int eid = 0; eid < cg.edge_count; eid++ ){
+
+		snid = cg.edges[eid].snid; enid = cg.edges[eid].enid; weight = cg.edges[eid].weight;
 
 		iweight = (int) (weight * WEIGHT_INFLATE_FACTOR + ROUND_FACTOR);
 
@@ -200,7 +197,7 @@ void init_input(){
 
 	}
 
-	fclose(fin);
+	cgraph_close( cg );
 
 	printf("COMPLETE.\n");
 
@@ -1262,6 +1259,8 @@ int main(int argc, char* argv[]){
 
 		printf("Usage: exec FILE_NODE FILE_EDGE WEIGHT_INFLATE_FACTOR FILE_MORTON FILE_OBJECT\n");
 
+		printf("FILE_NODE may be a binary graph of cgraph_convert, FILE_EDGE is ignored then\n");
+
 		exit(0);
 
 	}
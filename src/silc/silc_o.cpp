@@ -12,6 +12,7 @@
 #include<deque>
 #include<stack>
 #include<algorithm>
+#include"../cgraph/cgraph.h"
 #include<sys/time.h>
 using namespace std;
 
@@ -25,6 +26,7 @@ long ts, te;
 
 #define FILE_NODE "../../src/data/col.cnode"
 #define FILE_EDGE "../../src/data/col.cedge"
+#define FILE_GRAPH "../../src/data/col.cgraph" // binary graph of cgraph_convert, used instead of the text files if present
 
 #define FILE_MORTON "./data/col.morton"
 // cal=10000 SF=NA=100 ny=100000 e=100000 col=100000
@@ -69,35 +71,32 @@ double min_llx, min_lly;
 double max_urx, max_ury;
 
 void init_input(){
-	FILE *fin;
-
 	// load node
 	printf("LOADING NODE...");
-	fin = fopen(FILE_NODE,"r");
-	int nid;
+	CGraph cg;
+	if ( ! cgraph_load( FILE_GRAPH, FILE_NODE, FILE_EDGE, cg ) ) exit(1);
 	double x,y;
-	while( fscanf(fin, "%d %lf %lf", &nid, &x, &y ) == 3 ){
+	for ( int nid = 0; nid < cg.node_count; nid++ ){
+		x = cg.xy[2 * nid]; y = cg.xy[2 * nid + 1];
 		Node node = { x * WEIGHT_INFLATE_FACTOR, y * WEIGHT_INFLATE_FACTOR };
 		Nodes.push_back(node);
 	}
-	fclose(fin);
 	printf("COMPLETE. NODE_COUNT=%d\n", Nodes.size());
 
 	// load edge
 	printf("LOADING EDGE...");
-	fin = fopen(FILE_EDGE, "r");
-	int eid;
 	int snid, enid;
 	double weight;
 	int iweight;
-	while( fscanf(fin,"%d %d %d %lf", &eid, &snid, &enid, &weight ) == 4 ){
+	for ( int eid = 0; eid < cg.edge_count; eid++ ){
+		snid = cg.edges[eid].snid; enid = cg.edges[eid].enid; weight = cg.edges[eid].weight;
 		iweight = (int) (weight * WEIGHT_INFLATE_FACTOR + ROUND_FACTOR);
 		Nodes[snid].adjnodes.push_back( enid );
 		Nodes[snid].adjweight.push_back( iweight );
 		Nodes[enid].adjnodes.push_back( snid );
 		Nodes[enid].adjweight.push_back( iweight );
 	}
-	fclose(fin);
+	cgraph_close( cg );
 	printf("COMPLETE.\n");
 
 	// init get whole region